@@ -1,9 +1,22 @@
 QT += network
+# Coroutine request flows (apicoroutine.h) need C++20.
+CONFIG += c++2a
+# Content-Encoding support (contentdecoder.cpp).
+LIBS += -lz
 
 SOURCES += \
         $$PWD/apihandler.cpp \
+        $$PWD/apicoroutine.cpp \
+        $$PWD/apitransport.cpp \
+        $$PWD/contentdecoder.cpp \
+        $$PWD/histogram.cpp \
+        $$PWD/httptransport.cpp \
+        $$PWD/jsonstreamparser.cpp \
+        $$PWD/requestjournal.cpp \
+        $$PWD/xxhash64.cpp \
         $$PWD/caster.cpp \
         $$PWD/confighandler.cpp \
+        $$PWD/endpoints.cpp \
         $$PWD/filehandler.cpp \
         $$PWD/syncthingmanager.cpp \
         $$PWD/validater.cpp \
@@ -13,9 +26,20 @@ SOURCES += \
 
 HEADERS += \
         $$PWD/apihandler.h \
+        $$PWD/apicoroutine.h \
+        $$PWD/apitransport.h \
+        $$PWD/contentdecoder.h \
+        $$PWD/histogram.h \
+        $$PWD/httptransport.h \
+        $$PWD/jsonstreamparser.h \
+        $$PWD/mpscqueue.h \
+        $$PWD/requestjournal.h \
+        $$PWD/timerwheel.h \
+        $$PWD/xxhash64.h \
         $$PWD/caster.h \
         $$PWD/client_syncthingmanager.h \
         $$PWD/configHandler.h \
+        $$PWD/endpoints.h \
         $$PWD/filehandler.h \
         $$PWD/server_syncthingmanager.h \
         $$PWD/structbase.h \
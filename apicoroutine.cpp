@@ -0,0 +1,168 @@
+#include "apicoroutine.h"
+#include <QDebug>
+#include <QAbstractEventDispatcher>
+
+void ApiTask::promise_type::unhandled_exception()
+{
+    qCritical() << "Unhandled exception in an API coroutine; flow abandoned";
+}
+
+// Resumption is always posted: completions arrive from inside the handler's
+// reply bookkeeping, and the resumed flow is free to enqueue more requests.
+void ApiJoin::complete(int index, const ApiResult &result)
+{
+    {
+        QMutexLocker locker(&mutex);
+        if (resumed)
+            return;
+        results[index] = result;
+        if (winner < 0)
+            winner = index;
+        if (--remaining > 0)
+            return;
+        resumed = true;
+    }
+    const std::coroutine_handle<> handle = waiter;
+    const ApiCancelToken cancelLosers = losers;
+    ApiHandler *const handler = api;
+    QObject *const target = resumeOn ? resumeOn.data() : static_cast<QObject*>(handler);
+    QMetaObject::invokeMethod(target, [handler, handle, cancelLosers]() {
+        if (cancelLosers.isValid())
+            handler->cancel(cancelLosers);
+        handle.resume();
+    }, Qt::QueuedConnection);
+}
+
+namespace {
+
+// Lives in the request's onResult. Whoever drops the last copy without a
+// result having arrived (cancelled, shed, or withdrawn) reports one instead.
+struct JoinSlot {
+    std::shared_ptr<ApiJoin> join;
+    int index;
+    bool delivered = false;
+
+    ~JoinSlot()
+    {
+        if (delivered)
+            return;
+        ApiResult result;
+        result.error = QNetworkReply::OperationCanceledError;
+        result.errorString = QStringLiteral("Request withdrawn");
+        join->complete(index, result);
+    }
+};
+
+} // namespace
+
+ApiJoinAwaiter::ApiJoinAwaiter(ApiHandler *api, QVector<ApiRequest> requests, bool any)
+    : m_api(api),
+      m_requests(std::move(requests)),
+      m_any(any)
+{
+}
+
+void ApiJoinAwaiter::await_suspend(std::coroutine_handle<> waiter)
+{
+    m_join = std::make_shared<ApiJoin>();
+    m_join->api = m_api;
+    m_join->resumeOn = QAbstractEventDispatcher::instance();
+    m_join->waiter = waiter;
+    m_join->results.resize(m_requests.size());
+    m_join->remaining = m_any ? 1 : m_requests.size();
+    if (m_any)
+        m_join->losers = ApiCancelToken::create();
+
+    for (int i = 0; i < m_requests.size(); ++i) {
+        ApiRequest req = std::move(m_requests[i]);
+        if (m_any && !req.cancelToken.isValid())
+            req.cancelToken = m_join->losers;
+        const auto slot = std::make_shared<JoinSlot>();
+        slot->join = m_join;
+        slot->index = i;
+        req.callback = nullptr;
+        req.onResult = [slot](const ApiResult &result) {
+            slot->delivered = true;
+            slot->join->complete(slot->index, result);
+        };
+        m_api->enqueueRequest(std::move(req));
+    }
+    m_requests.clear();
+}
+
+ApiCall::ApiCall(ApiHandler *api, ApiRequest req)
+    : ApiJoinAwaiter(api, QVector<ApiRequest>{std::move(req)}, false)
+{
+}
+
+ApiResult ApiCall::await_resume() const
+{
+    return m_join->results.at(0);
+}
+
+QVector<ApiRequest> ApiJoinAwaiter::requestsOf(const QVector<ApiCall> &calls)
+{
+    QVector<ApiRequest> requests;
+    requests.reserve(calls.size());
+    for (const ApiCall &call : calls)
+        requests.append(call.m_requests.value(0));
+    return requests;
+}
+
+ApiAllAwaiter::ApiAllAwaiter(const QVector<ApiCall> &calls)
+    : ApiJoinAwaiter(calls.isEmpty() ? nullptr : calls.first().m_api, requestsOf(calls), false)
+{
+}
+
+QVector<ApiResult> ApiAllAwaiter::await_resume() const
+{
+    return m_join ? m_join->results : QVector<ApiResult>();
+}
+
+ApiAnyAwaiter::ApiAnyAwaiter(const QVector<ApiCall> &calls)
+    : ApiJoinAwaiter(calls.isEmpty() ? nullptr : calls.first().m_api, requestsOf(calls), true)
+{
+}
+
+ApiAnyResult ApiAnyAwaiter::await_resume() const
+{
+    ApiAnyResult any;
+    if (m_join) {
+        any.index = m_join->winner;
+        any.result = m_join->results.at(any.index);
+    }
+    return any;
+}
+
+// ApiHandler's awaitable entry points live here so apihandler.h itself
+// does not need C++20.
+ApiCall ApiHandler::send(ApiRequest req)
+{
+    return ApiCall(this, std::move(req));
+}
+
+ApiCall ApiHandler::get(const QUrl &url)
+{
+    ApiRequest req;
+    req.method = ApiRequest::GET;
+    req.url = url;
+    return ApiCall(this, std::move(req));
+}
+
+ApiCall ApiHandler::post(const QUrl &url, const QByteArray &payload)
+{
+    ApiRequest req;
+    req.method = ApiRequest::POST;
+    req.url = url;
+    req.payload = payload;
+    return ApiCall(this, std::move(req));
+}
+
+ApiCall ApiHandler::put(const QUrl &url, const QByteArray &payload)
+{
+    ApiRequest req;
+    req.method = ApiRequest::PUT;
+    req.url = url;
+    req.payload = payload;
+    return ApiCall(this, std::move(req));
+}
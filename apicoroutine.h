@@ -0,0 +1,133 @@
+#ifndef APICOROUTINE_H
+#define APICOROUTINE_H
+
+#include "apihandler.h"
+#include <QVector>
+#include <QMutex>
+#include <QPointer>
+#include <coroutine>
+#include <memory>
+#include <utility>
+
+// C++20 coroutine layer over ApiHandler. A multi-step flow is written as an
+// ApiTask that awaits its requests instead of nesting callbacks:
+//
+//     ApiTask SyncthingManager::someFlow(QString id)
+//     {
+//         const QVector<ApiResult> r = co_await whenAll(api->get(a), api->get(b));
+//         ...
+//         const ApiResult posted = co_await api->post(url, payload);
+//     }
+//
+// Awaiting always suspends, and the coroutine resumes in the event loop of
+// the thread that awaited, even when ApiHandler runs on its own thread. If a request is cancelled or shed without a result, the flow
+// still resumes, with OperationCanceledError, so no frame is left hanging.
+// Coroutine parameters should be taken by value; references would dangle
+// across the first suspension.
+
+// Fire-and-forget coroutine: runs eagerly and frees itself when it ends.
+class ApiTask
+{
+public:
+    struct promise_type {
+        ApiTask get_return_object() { return ApiTask(); }
+        std::suspend_never initial_suspend() noexcept { return {}; }
+        std::suspend_never final_suspend() noexcept { return {}; }
+        void return_void() {}
+        void unhandled_exception();
+    };
+};
+
+// State shared by the requests of one co_await. The coroutine is resumed
+// once: after every result (whenAll) or after the first one (whenAny).
+// Completions may arrive from more than one thread.
+struct ApiJoin {
+    ApiHandler *api = nullptr;
+    QPointer<QObject> resumeOn;  // Event dispatcher of the awaiting thread.
+    std::coroutine_handle<> waiter;
+    QMutex mutex;
+    QVector<ApiResult> results;
+    int remaining = 0;      // Results still needed before resuming.
+    int winner = -1;        // Index of the first request to finish.
+    bool resumed = false;
+    ApiCancelToken losers;  // whenAny: withdraws the requests that lost.
+
+    void complete(int index, const ApiResult &result);
+};
+
+class ApiCall;
+
+// Base for the awaiters: sends the requests when the coroutine suspends.
+class ApiJoinAwaiter
+{
+public:
+    bool await_ready() const noexcept { return m_requests.isEmpty(); }
+    void await_suspend(std::coroutine_handle<> waiter);
+
+protected:
+    ApiJoinAwaiter(ApiHandler *api, QVector<ApiRequest> requests, bool any);
+    static QVector<ApiRequest> requestsOf(const QVector<ApiCall> &calls);
+
+    ApiHandler *m_api;
+    QVector<ApiRequest> m_requests;
+    bool m_any;
+    std::shared_ptr<ApiJoin> m_join;
+};
+
+// co_await on a single request yields its ApiResult.
+class ApiCall : public ApiJoinAwaiter
+{
+public:
+    ApiCall(ApiHandler *api, ApiRequest req);
+    ApiResult await_resume() const;
+
+private:
+    friend class ApiAllAwaiter;
+    friend class ApiAnyAwaiter;
+};
+
+// Yields every result, in argument order.
+class ApiAllAwaiter : public ApiJoinAwaiter
+{
+public:
+    explicit ApiAllAwaiter(const QVector<ApiCall> &calls);
+    QVector<ApiResult> await_resume() const;
+};
+
+struct ApiAnyResult {
+    int index = -1;  // Which call finished first.
+    ApiResult result;
+};
+
+// Yields the first call to finish, successful or not. The others are
+// cancelled unless they carry a cancel token of their own.
+class ApiAnyAwaiter : public ApiJoinAwaiter
+{
+public:
+    explicit ApiAnyAwaiter(const QVector<ApiCall> &calls);
+    ApiAnyResult await_resume() const;
+};
+
+inline ApiAllAwaiter whenAll(const QVector<ApiCall> &calls)
+{
+    return ApiAllAwaiter(calls);
+}
+
+template <typename... Calls>
+ApiAllAwaiter whenAll(Calls &&... calls)
+{
+    return ApiAllAwaiter(QVector<ApiCall>{std::forward<Calls>(calls)...});
+}
+
+inline ApiAnyAwaiter whenAny(const QVector<ApiCall> &calls)
+{
+    return ApiAnyAwaiter(calls);
+}
+
+template <typename... Calls>
+ApiAnyAwaiter whenAny(Calls &&... calls)
+{
+    return ApiAnyAwaiter(QVector<ApiCall>{std::forward<Calls>(calls)...});
+}
+
+#endif // APICOROUTINE_H
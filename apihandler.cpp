@@ -2,26 +2,156 @@
 #include <QDebug>
 #include <QNetworkRequest>
 #include <QTimer>
-#include <limits>
+#include <QRandomGenerator>
+#include <QThread>
+#include <QCoreApplication>
+#include <QAbstractEventDispatcher>
+#include <QPointer>
+#include <QtAlgorithms>
+#include <QtMath>
+#include "urlbase.h"
+#include "jsonstreamparser.h"
+#include "contentdecoder.h"
+#include "requestjournal.h"
+#include "xxhash64.h"
 
 Q_LOGGING_CATEGORY(SyncthingHandlerLog, "syncthinghandler")
+// Routine journal decisions; off unless QT_LOGGING_RULES enables
+// "syncthinghandler.journal.debug".
+Q_LOGGING_CATEGORY(SyncthingJournalLog, "syncthinghandler.journal", QtWarningMsg)
 
 static ApiHandler* instance = nullptr;
 
-ApiHandler::~ApiHandler() {}
+ApiCancelToken ApiCancelToken::create()
+{
+    ApiCancelToken token;
+    token.m_cancelled = std::make_shared<std::atomic<bool>>(false);
+    return token;
+}
+
+void ApiCancelToken::cancel() const
+{
+    if (m_cancelled)
+        m_cancelled->store(true);
+}
+
+ApiHandler::~ApiHandler()
+{
+    // Drop decodes not started yet and wait out the running ones; their
+    // results, posted back to this object, are discarded with it.
+    if (m_decodePool) {
+        m_decodePool->clear();
+        m_decodePool->waitForDone();
+    }
+    qDeleteAll(m_decoding);
+    for (RequestLane &lane : m_lanes)
+        qDeleteAll(lane.queue);
+    for (const QQueue<ApiRequest*> &parked : m_parked)
+        qDeleteAll(parked);
+    for (const InFlight &flight : m_inFlight) {
+        if (!flight.isHedge || !flight.partner)  // A hedged pair shares its node.
+            delete flight.req;
+    }
+    delete m_journal;  // Writes out what is still buffered.
+}
+
+ApiHandler::RequestPool::~RequestPool()
+{
+    qDeleteAll(m_free);
+}
+
+ApiRequest *ApiHandler::RequestPool::acquire(ApiRequest &&req)
+{
+    if (m_free.isEmpty())
+        return new ApiRequest(std::move(req));
+    ApiRequest *node = m_free.takeLast();
+    *node = std::move(req);
+    return node;
+}
+
+// Clearing the node drops its callbacks and payload right away; the node
+// itself is kept for the next request.
+void ApiHandler::RequestPool::release(ApiRequest *req)
+{
+    if (m_free.size() >= m_maxFree) {
+        delete req;
+        return;
+    }
+    *req = ApiRequest();
+    m_free.append(req);
+}
+
+void ApiHandler::RequestPool::setMaxFree(int maxFree)
+{
+    m_maxFree = qMax(0, maxFree);
+    while (m_free.size() > m_maxFree)
+        delete m_free.takeLast();
+}
 
 ApiHandler::ApiHandler(QObject *parent)
     : QObject(parent),
-      m_requestInProgress(false),
-      m_networkManager(new QNetworkAccessManager(this)),
-      m_maxRetries(1),          // Default: one retry.
+      m_queuedCount(0),
+      m_currentLane(ApiRequest::ControlLane),
+      m_maxInFlight(4),         // Default: four requests on the wire.
+      m_transport(new NetworkManagerTransport(this)),
+      m_timer(this),            // A child, so it follows moveToThread().
+      m_throttleTimer(this),
+      m_wheelTimer(this),
       m_maxQueueSize(20),       // Default queue limit is 10.
-      m_pollingInterval(200),   // Process queue every 100ms.
-      m_requestTimeoutMs(100)  // Request timeout set to 1 second.
+      m_pollingInterval(1000),  // Fallback sweep while work is waiting.
+      m_requestTimeoutMs(1000), // Initial timeout until an endpoint has samples.
+      m_dispatchScheduled(false),
+      m_coalescedCount(0),
+      m_supersededCount(0),
+      m_cacheGeneration(0),
+      m_minTimeoutMs(250),
+      m_maxTimeoutMs(30000),
+      m_retryTokens(10),
+      m_retryBudgetRatio(0.2),  // Retries may add at most 20% to the traffic.
+      m_retryBudgetBurst(10),
+      m_circuitState(CircuitClosed),
+      m_circuitPolicy(ParkRequests),
+      m_consecutiveFailures(0),
+      m_circuitThreshold(3),
+      m_circuitBaseOpenMs(1000),
+      m_circuitMaxOpenMs(30000),
+      m_circuitOpenMs(1000),
+      m_streamBufferLimit(1024 * 1024),
+      m_hedgeTokens(3),
+      m_hedgeBudgetRatio(0.05), // Hedges may add at most 5% to the traffic.
+      m_hedgeBudgetBurst(3),
+      m_drainScheduled(false),
+      m_workerThread(nullptr),
+      m_repliesHandled(0),
+      m_handlerUs(0),
+      m_callerUs(0),
+      m_decodePool(nullptr),
+      m_decodeMinBytes(0),
+      m_maxPendingDecodes(4),
+      m_journal(nullptr)
 {
-    // Start the timer to process requests.
+    qRegisterMetaType<ApiHandler::CircuitState>("ApiHandler::CircuitState");
+    m_clock.start();
+
+    // Requests are dispatched as soon as they are enqueued or a slot frees up;
+    // the timer only sweeps the queue while something is waiting.
     connect(&m_timer, &QTimer::timeout, this, &ApiHandler::onTimerTick);
-    m_timer.start(m_pollingInterval);
+    m_throttleTimer.setSingleShot(true);
+    connect(&m_throttleTimer, &QTimer::timeout, this, &ApiHandler::processNextRequest);
+    m_wheelTimer.setSingleShot(true);
+    connect(&m_wheelTimer, &QTimer::timeout, this, &ApiHandler::onWheelTick);
+
+    // Config changes must never be shed for telemetry, so the control lane
+    // rejects new work when full instead of evicting queued mutations.
+    setLaneConfig(ApiRequest::ControlLane, 32, 4, RejectNewest);
+    setLaneConfig(ApiRequest::StateLane, m_maxQueueSize, 2, DropOldest);
+    setLaneConfig(ApiRequest::TelemetryLane, 8, 1, DropOldest);
+
+    // Reads are idempotent and cheap to repeat; a full-config write is neither.
+    setRetryPolicy(ApiRequest::GET, RetryPolicy{3, 100, 5000});
+    for (ApiRequest::HttpMethod method : {ApiRequest::POST, ApiRequest::PATCH,
+                                          ApiRequest::PUT, ApiRequest::DELETE_})
+        setRetryPolicy(method, RetryPolicy{1, 500, 10000});
 }
 
 ApiHandler* ApiHandler::getInstance()
@@ -31,173 +161,1768 @@ ApiHandler* ApiHandler::getInstance()
     return instance;
 }
 
+void ApiHandler::startWorkerThread()
+{
+    if (m_workerThread)
+        return;
+    m_workerThread = new QThread();
+    m_workerThread->setObjectName(QStringLiteral("ApiHandler"));
+    moveToThread(m_workerThread);
+    QThread *worker = m_workerThread;
+    if (QCoreApplication *app = QCoreApplication::instance()) {
+        connect(app, &QCoreApplication::aboutToQuit, app, [worker]() {
+            worker->quit();
+            worker->wait();
+        });
+    }
+    m_workerThread->start();
+    qDebug() << "ApiHandler now runs on its own thread";
+}
+
+bool ApiHandler::isWorkerThreadRunning() const
+{
+    return m_workerThread && m_workerThread->isRunning();
+}
+
 void ApiHandler::setApiKey(const QString &apiKey)
 {
+    if (postToOwnThread([this, apiKey]() { setApiKey(apiKey); }))
+        return;
     m_apiKey = apiKey;
 }
 
 void ApiHandler::setBaseUrl(const QUrl &baseUrl)
 {
+    if (postToOwnThread([this, baseUrl]() { setBaseUrl(baseUrl); }))
+        return;
     m_baseUrl = baseUrl;
+    m_endpoints.rebase(baseUrl);
+}
+
+const QUrl &ApiHandler::endpointUrl(Endpoint endpoint) const
+{
+    return m_endpoints.url(endpoint);
+}
+
+QUrl ApiHandler::endpointUrl(Endpoint endpoint, const QString &item) const
+{
+    return m_endpoints.url(endpoint, item);
+}
+
+void ApiHandler::setTransport(ApiTransport *transport)
+{
+    if (!transport || transport == m_transport)
+        return;
+    // Only the transport's current thread may hand it over.
+    if (transport->thread() != thread())
+        transport->moveToThread(thread());
+    if (postToOwnThread([this, transport]() { setTransport(transport); }))
+        return;
+    // Replies already on the wire keep their own connections to the old transport.
+    m_transport->deleteLater();
+    m_transport = transport;
+    m_transport->setParent(this);
 }
 
 void ApiHandler::setRetryCount(int maxRetries)
 {
-    m_maxRetries = maxRetries;
-    qDebug() << "Max retries set to" << m_maxRetries;
+    if (postToOwnThread([this, maxRetries]() { setRetryCount(maxRetries); }))
+        return;
+    for (RetryPolicy &policy : m_retryPolicies)
+        policy.maxRetries = maxRetries;
+    qDebug() << "Max retries set to" << maxRetries;
+}
+
+void ApiHandler::setRetryPolicy(ApiRequest::HttpMethod method, const RetryPolicy &policy)
+{
+    if (postToOwnThread([this, method, policy]() { setRetryPolicy(method, policy); }))
+        return;
+    m_retryPolicies[method] = policy;
+}
+
+void ApiHandler::setRetryBudget(double ratio, int burst)
+{
+    if (postToOwnThread([this, ratio, burst]() { setRetryBudget(ratio, burst); }))
+        return;
+    m_retryBudgetRatio = qMax(0.0, ratio);
+    m_retryBudgetBurst = qMax(0, burst);
+    m_retryTokens = qMin(m_retryTokens, double(m_retryBudgetBurst));
+}
+
+ApiHandler::RetryStats ApiHandler::getRetryStats() const
+{
+    return m_retryStats;
+}
+
+void ApiHandler::setCircuitBreaker(int failureThreshold, int openMs, int maxOpenMs)
+{
+    if (postToOwnThread([=, this]() { setCircuitBreaker(failureThreshold, openMs, maxOpenMs); }))
+        return;
+    m_circuitThreshold = qMax(1, failureThreshold);
+    m_circuitBaseOpenMs = qMax(1, openMs);
+    m_circuitMaxOpenMs = qMax(m_circuitBaseOpenMs, maxOpenMs);
+    m_circuitOpenMs = m_circuitBaseOpenMs;
+}
+
+void ApiHandler::setCircuitPolicy(CircuitPolicy policy)
+{
+    if (postToOwnThread([this, policy]() { setCircuitPolicy(policy); }))
+        return;
+    m_circuitPolicy = policy;
+}
+
+ApiHandler::CancelStats ApiHandler::getCancelStats() const
+{
+    return m_cancelStats;
+}
+
+ApiHandler::CircuitState ApiHandler::getCircuitState() const
+{
+    return m_circuitState;
+}
+
+QHash<QString, ApiHandler::EndpointMetrics> ApiHandler::getEndpointMetrics() const
+{
+    return m_metrics;
+}
+
+void ApiHandler::resetEndpointMetrics()
+{
+    if (postToOwnThread([this]() { resetEndpointMetrics(); }))
+        return;
+    m_metrics.clear();
+}
+
+ApiHandler::ThreadStats ApiHandler::getThreadStats() const
+{
+    ThreadStats stats;
+    stats.replies = m_repliesHandled.load();
+    stats.handlerUs = m_handlerUs.load();
+    stats.callerUs = m_callerUs.load();
+    return stats;
+}
+
+qint64 ApiHandler::nowUs() const
+{
+    return m_clock.nsecsElapsed() / 1000;
+}
+
+void ApiHandler::recordEviction(const ApiRequest &req)
+{
+    ++m_metrics[timeoutKey(req)].evictions;
 }
 
 void ApiHandler::setQueueLimit(int limit)
 {
-    std::lock_guard<std::mutex> lock(m_queueMutex);
-    m_maxQueueSize = limit;
+    if (postToOwnThread([this, limit]() { setQueueLimit(limit); }))
+        return;
+    m_maxQueueSize = qMax(1, limit);
     qDebug() << "Max queue size set to" << m_maxQueueSize;
-    // Remove excess requests if current queue exceeds the new limit.
-    while (m_requestQueue.size() > m_maxQueueSize) {
-        int lowestPriority = std::numeric_limits<int>::max();
-        int removeIndex = -1;
-        for (int i = 0; i < m_requestQueue.size(); ++i) {
-            if (m_requestQueue.at(i).priority < lowestPriority) {
-                lowestPriority = m_requestQueue.at(i).priority;
-                removeIndex = i;
-            }
-        }
-        if (removeIndex != -1) {
-            ApiRequest removed = m_requestQueue.takeAt(removeIndex);
-            qDebug() << "Removed request due to queue limit:" << removed.url.toString()
-                     << "with priority:" << removed.priority;
-            emit globalError(QString("Removed request %1 due to queue limit")
-                             .arg(removed.url.toString()));
-            emit queueSizeChanged(m_requestQueue.size());
-        }
+    // Only the state lane follows the limit; control and telemetry keep their
+    // own sizes (see setLaneConfig()).
+    RequestLane &lane = m_lanes[ApiRequest::StateLane];
+    lane.capacity = m_maxQueueSize;
+    // A RejectNewest lane only refuses new work; what it holds drains normally.
+    while (lane.policy == DropOldest && lane.size() > lane.capacity && !lane.queue.isEmpty()) {
+        ApiRequest *removed = takeQueued(lane, 0);
+        --m_queuedCount;
+        ++lane.stats.evicted;
+        recordEviction(*removed);
+        qDebug() << "Removed request due to queue limit:" << removed->url.toString();
+        emit globalError(QString("Removed request %1 due to queue limit")
+                         .arg(removed->url.toString()));
+        emit queueSizeChanged(m_queuedCount);
+        settleJournal(*removed);
+        dropRequest(*removed, QStringLiteral("Removed due to queue limit"));
+        m_requestPool.release(removed);
     }
 }
 
 void ApiHandler::setRequestTimeout(int timeoutMs)
 {
+    if (postToOwnThread([this, timeoutMs]() { setRequestTimeout(timeoutMs); }))
+        return;
     m_requestTimeoutMs = timeoutMs;
     qDebug() << "Request timeout set to" << m_requestTimeoutMs << "ms";
 }
 
+void ApiHandler::setTimeoutBounds(int floorMs, int ceilingMs)
+{
+    if (postToOwnThread([this, floorMs, ceilingMs]() { setTimeoutBounds(floorMs, ceilingMs); }))
+        return;
+    m_minTimeoutMs = qMax(1, floorMs);
+    m_maxTimeoutMs = qMax(m_minTimeoutMs, ceilingMs);
+    for (EndpointTimeout &est : m_timeouts)
+        est.timeoutMs = qBound(m_minTimeoutMs, est.timeoutMs, m_maxTimeoutMs);
+}
+
+QHash<QString, ApiHandler::EndpointTimeout> ApiHandler::getEndpointTimeouts() const
+{
+    return m_timeouts;
+}
+
+void ApiHandler::setMaxInFlight(int maxInFlight)
+{
+    if (postToOwnThread([this, maxInFlight]() { setMaxInFlight(maxInFlight); }))
+        return;
+    m_maxInFlight = qMax(1, maxInFlight);
+    qDebug() << "Max in-flight requests set to" << m_maxInFlight;
+}
+
+void ApiHandler::setEndpointInFlightLimit(const QString &path, int limit)
+{
+    if (postToOwnThread([this, path, limit]() { setEndpointInFlightLimit(path, limit); }))
+        return;
+    if (limit > 0)
+        m_endpointLimits.insert(endpointKey(QUrl(path)), limit);
+    else
+        m_endpointLimits.remove(endpointKey(QUrl(path)));
+}
+
+void ApiHandler::setRateLimit(ApiRequest::HttpMethod method, const QString &path,
+                              double ratePerSecond, int burst)
+{
+    if (postToOwnThread([=, this]() { setRateLimit(method, path, ratePerSecond, burst); }))
+        return;
+    ApiRequest probe;
+    probe.method = method;
+    probe.url = QUrl(path);
+    const QString key = timeoutKey(probe);
+    if (ratePerSecond <= 0) {
+        m_rateLimits.remove(key);
+        return;
+    }
+    TokenBucket &bucket = m_rateLimits[key];
+    bucket.rate = ratePerSecond;
+    bucket.burst = qMax(1, burst);
+    bucket.tokens = bucket.burst;  // Start full.
+    bucket.updatedAtUs = nowUs();
+    qDebug() << "Rate limit for" << key << "set to" << ratePerSecond << "/s, burst" << bucket.burst;
+}
+
+void ApiHandler::setLaneConfig(ApiRequest::Lane lane, int capacity, int weight,
+                               OverflowPolicy policy)
+{
+    if (postToOwnThread([=, this]() { setLaneConfig(lane, capacity, weight, policy); }))
+        return;
+    if (lane < 0 || lane >= ApiRequest::LaneCount)
+        return;
+    m_lanes[lane].capacity = qMax(1, capacity);
+    m_lanes[lane].weight = qMax(1, weight);
+    m_lanes[lane].policy = policy;
+}
+
+ApiHandler::LaneStats ApiHandler::getLaneStats(ApiRequest::Lane lane) const
+{
+    if (lane < 0 || lane >= ApiRequest::LaneCount)
+        return LaneStats();
+    LaneStats stats = m_lanes[lane].stats;
+    stats.queued = m_lanes[lane].size();
+    return stats;
+}
+
+// Mutations go to the control lane, liveness probes and event polls to
+// telemetry, and every other read to the state lane.
+ApiRequest::Lane ApiHandler::laneFor(const ApiRequest &req)
+{
+    if (req.lane != ApiRequest::AutoLane)
+        return req.lane;
+    if (req.method != ApiRequest::GET)
+        return ApiRequest::ControlLane;
+    const QString path = endpointKey(req);
+    if (path == QLatin1String(HEALTH) || path == QLatin1String(PING) || path == QLatin1String(EVENTS))
+        return ApiRequest::TelemetryLane;
+    return ApiRequest::StateLane;
+}
+
+void ApiHandler::setCacheTtl(const QString &path, int ttlMs)
+{
+    if (postToOwnThread([this, path, ttlMs]() { setCacheTtl(path, ttlMs); }))
+        return;
+    if (ttlMs > 0)
+        m_cacheTtls.insert(endpointKey(QUrl(path)), ttlMs);
+    else
+        m_cacheTtls.remove(endpointKey(QUrl(path)));
+}
+
+void ApiHandler::clearCache()
+{
+    if (postToOwnThread([this]() { clearCache(); }))
+        return;
+    m_cache.clear();
+}
+
+void ApiHandler::setJournal(const QString &path, int maxAgeSecs)
+{
+    if (postToOwnThread([this, path, maxAgeSecs]() { setJournal(path, maxAgeSecs); }))
+        return;
+    if (m_journal)
+        return;
+    RequestJournal *journal = new RequestJournal(path);
+    QVector<RequestJournal::Entry> pending;
+    if (!journal->open(maxAgeSecs, pending)) {
+        emit globalError(QString("Cannot open request journal %1: %2").arg(path, journal->errorString()));
+        delete journal;
+        return;
+    }
+    m_journal = journal;
+    if (QCoreApplication *app = QCoreApplication::instance())
+        connect(app, &QCoreApplication::aboutToQuit, this, [journal]() { journal->flush(); },
+                Qt::DirectConnection);
+    if (!pending.isEmpty())
+        qDebug() << "Replaying" << pending.size() << "journaled requests";
+    for (const RequestJournal::Entry &entry : pending) {
+        ApiRequest req;
+        req.method = entry.method;
+        req.url = m_baseUrl;
+        req.url.setPath(entry.url.path());
+        req.url.setQuery(entry.url.query());
+        req.payload = entry.payload;
+        req.orderingKey = entry.orderingKey;
+        req.journalIntent = entry.intent;
+        req.journalId = entry.id;
+        const QString intent = entry.intent;
+        req.onResult = [this, intent](const ApiResult &result) {
+            if (result.ok())
+                qDebug() << "Replayed journaled request:" << intent;
+            else
+                emit globalError(QString("Replayed request \"%1\" failed: %2").arg(intent, result.errorString));
+        };
+        enqueueRequest(std::move(req));
+    }
+}
+
+ApiHandler::JournalStats ApiHandler::getJournalStats() const
+{
+    return m_journal ? m_journal->stats() : JournalStats();
+}
+
+// Settled entries are not replayed: the request was answered, or its caller
+// gave up on it. Requests that never reached a reachable daemon stay open.
+void ApiHandler::settleJournal(const ApiRequest &req)
+{
+    if (m_journal && req.journalId != 0)
+        m_journal->settle(req.journalId);
+}
+
+void ApiHandler::forgetUnchanged(const QString &unchangedKey)
+{
+    if (postToOwnThread([this, unchangedKey]() { forgetUnchanged(unchangedKey); }))
+        return;
+    m_lastBodies.remove(unchangedKey);
+}
+
+void ApiHandler::setHedging(const QString &path, bool enabled)
+{
+    if (postToOwnThread([this, path, enabled]() { setHedging(path, enabled); }))
+        return;
+    if (enabled)
+        m_hedgedEndpoints.insert(endpointKey(QUrl(path)));
+    else
+        m_hedgedEndpoints.remove(endpointKey(QUrl(path)));
+}
+
+void ApiHandler::setHedgeBudget(double ratio, int burst)
+{
+    if (postToOwnThread([this, ratio, burst]() { setHedgeBudget(ratio, burst); }))
+        return;
+    m_hedgeBudgetRatio = qMax(0.0, ratio);
+    m_hedgeBudgetBurst = qMax(0, burst);
+    m_hedgeTokens = qMin(m_hedgeTokens, double(m_hedgeBudgetBurst));
+}
+
+ApiHandler::HedgeStats ApiHandler::getHedgeStats() const
+{
+    return m_hedgeStats;
+}
+
+void ApiHandler::setCompression(const QString &path, bool enabled)
+{
+    if (postToOwnThread([this, path, enabled]() { setCompression(path, enabled); }))
+        return;
+    if (enabled)
+        m_compressedEndpoints.insert(endpointKey(QUrl(path)));
+    else
+        m_compressedEndpoints.remove(endpointKey(QUrl(path)));
+}
+
+void ApiHandler::setRequestPoolLimit(int nodes)
+{
+    if (postToOwnThread([this, nodes]() { setRequestPoolLimit(nodes); }))
+        return;
+    m_requestPool.setMaxFree(nodes);
+}
+
+void ApiHandler::setStreamBufferLimit(int bytes)
+{
+    if (postToOwnThread([this, bytes]() { setStreamBufferLimit(bytes); }))
+        return;
+    m_streamBufferLimit = qMax(0, bytes);
+}
+
+void ApiHandler::setDecodeOffload(int minBytes, int maxPending)
+{
+    if (postToOwnThread([this, minBytes, maxPending]() { setDecodeOffload(minBytes, maxPending); }))
+        return;
+    m_decodeMinBytes = qMax(0, minBytes);
+    m_maxPendingDecodes = qMax(1, maxPending);
+    if (m_decodeMinBytes > 0 && !m_decodePool) {
+        m_decodePool = new QThreadPool(this);
+        m_decodePool->setMaxThreadCount(qBound(1, QThread::idealThreadCount() / 2, 4));
+    }
+}
+
+ApiHandler::DecodeStats ApiHandler::getDecodeStats() const
+{
+    return m_decodeStats;
+}
+
+ApiHandler::ChangeStats ApiHandler::getChangeStats() const
+{
+    return m_changeStats;
+}
+
+ApiHandler::RateLimitStats ApiHandler::getRateLimitStats() const
+{
+    return m_rateLimitStats;
+}
+
+ApiHandler::CacheStats ApiHandler::getCacheStats() const
+{
+    CacheStats stats = m_cacheStats;
+    stats.entries = m_cache.size();
+    return stats;
+}
+
+int ApiHandler::cacheTtlFor(const ApiRequest &req) const
+{
+    if (!isCoalescable(req) || m_cacheTtls.isEmpty())
+        return 0;
+    return m_cacheTtls.value(endpointKey(req), 0);
+}
+
+// Answer a GET from a fresh cache entry. The callback still runs from the
+// event loop, as it would for a network reply.
+bool ApiHandler::serveFromCache(const ApiRequest &req)
+{
+    if (cacheTtlFor(req) <= 0)
+        return false;
+    auto it = m_cache.find(req.url);
+    if (it == m_cache.end() || it->expiresAtMs <= m_clock.elapsed() || writePendingFor(req.url)) {
+        if (it != m_cache.end())
+            m_cache.erase(it);
+        ++m_cacheStats.misses;
+        return false;
+    }
+    ++m_cacheStats.hits;
+    ApiResult result = it->result;
+    if (!req.unchangedKey.isEmpty() && !reuseUnchanged(req.unchangedKey, result))
+        rememberBody(req.unchangedKey, result);
+    const ApiResultCallback callback = req.onResult;
+    QMetaObject::invokeMethod(this, [callback, result]() {
+        callback(result);
+    }, Qt::QueuedConnection);
+    return true;
+}
+
+// Config writes only touch config reads; any other write may change
+// runtime state, so it drops everything.
+void ApiHandler::invalidateCache(const QUrl &writtenUrl)
+{
+    ++m_cacheGeneration;
+    if (m_cache.isEmpty())
+        return;
+    const bool configWrite = isConfigPath(writtenUrl.path());
+    for (auto it = m_cache.begin(); it != m_cache.end();) {
+        if (!configWrite || isConfigPath(it.key().path())) {
+            it = m_cache.erase(it);
+            ++m_cacheStats.invalidations;
+        } else {
+            ++it;
+        }
+    }
+}
+
+bool ApiHandler::isConfigPath(const QString &path)
+{
+    return path == QLatin1String(CONFIG) || path.startsWith(QLatin1String("/rest/config"));
+}
+
+// Until a related write is answered, the cache neither serves nor stores
+// the read: a read-modify-write must see the write, not what preceded it.
+bool ApiHandler::writePendingFor(const QUrl &readUrl) const
+{
+    const bool configRead = isConfigPath(readUrl.path());
+    auto affects = [configRead](const ApiRequest &req) {
+        return req.method != ApiRequest::GET && (configRead || !isConfigPath(req.url.path()));
+    };
+    for (const RequestLane &lane : m_lanes) {
+        for (const ApiRequest *node : lane.queue) {
+            if (affects(*node))
+                return true;
+        }
+    }
+    for (const QQueue<ApiRequest*> &parked : m_parked) {
+        for (const ApiRequest *node : parked) {
+            if (affects(*node))
+                return true;
+        }
+    }
+    for (const InFlight &flight : m_inFlight) {
+        if (affects(*flight.req))
+            return true;
+    }
+    return false;
+}
+
+// Wait-free for the producer: push, then post a single wake-up to this
+// thread unless one is already pending.
+void ApiHandler::submitRequest(ApiRequest req, QObject *context)
+{
+    // Without a context, results go back to the thread that asked.
+    if (!context && QThread::currentThread() != thread())
+        context = QAbstractEventDispatcher::instance();
+    if (context && context->thread() != thread())
+        bindCallbacksTo(req, context);
+    if (QThread::currentThread() == thread()) {
+        enqueueRequest(std::move(req));
+        return;
+    }
+    m_submissions.push(std::move(req));
+    if (!m_drainScheduled.exchange(true))
+        QMetaObject::invokeMethod(this, &ApiHandler::drainSubmissions, Qt::QueuedConnection);
+}
+
+void ApiHandler::drainSubmissions()
+{
+    // Clear the flag first: a push racing with this drain posts a new wake-up.
+    m_drainScheduled.store(false);
+    ApiRequest req;
+    while (m_submissions.pop(req))
+        enqueueRequest(std::move(req));
+}
+
+// Queued requests are withdrawn right away; replies already on the wire are
+// aborted and finish without running any callback.
+void ApiHandler::cancel(const ApiCancelToken &token)
+{
+    if (!token.isValid())
+        return;
+    token.cancel();
+    if (QThread::currentThread() == thread())
+        sweepWithdrawn();
+    else
+        QMetaObject::invokeMethod(this, &ApiHandler::sweepWithdrawn, Qt::QueuedConnection);
+}
+
+bool ApiHandler::isWithdrawn(const ApiRequest &req)
+{
+    return req.cancelToken.isCancelled() || req.deadline.hasExpired();
+}
+
+// Cancelled requests vanish silently; expired ones still tell their caller.
+void ApiHandler::withdrawQueued(ApiRequest *node)
+{
+    --m_queuedCount;
+    settleJournal(*node);
+    if (node->cancelToken.isCancelled()) {
+        ++m_cancelStats.cancelledQueued;
+    } else {
+        ++m_cancelStats.expiredQueued;
+        dropRequest(*node, QStringLiteral("Deadline exceeded"));
+    }
+    m_requestPool.release(node);
+}
+
+void ApiHandler::sweepWithdrawn()
+{
+    const int queuedBefore = m_queuedCount;
+    for (RequestLane &lane : m_lanes) {
+        for (int i = 0; i < lane.queue.size();) {
+            if (isWithdrawn(*lane.queue.at(i)))
+                withdrawQueued(takeQueued(lane, i));
+            else
+                ++i;
+        }
+    }
+    for (auto parked = m_parked.begin(); parked != m_parked.end();) {
+        for (int i = 0; i < parked->size();) {
+            if (isWithdrawn(*parked->at(i))) {
+                ApiRequest *node = parked->takeAt(i);
+                --m_lanes[node->lane].parked;
+                withdrawQueued(node);
+            } else {
+                ++i;
+            }
+        }
+        if (parked->isEmpty())
+            parked = m_parked.erase(parked);
+        else
+            ++parked;
+    }
+    if (m_queuedCount != queuedBefore)
+        emit queueSizeChanged(m_queuedCount);
+
+    // Aborting finishes a reply synchronously, so collect before aborting.
+    QList<QNetworkReply*> cancelled;
+    for (auto it = m_inFlight.begin(); it != m_inFlight.end(); ++it) {
+        if (!it->cancelled && it->req->cancelToken.isCancelled()) {
+            it->cancelled = true;
+            cancelled.append(it.key());
+        }
+    }
+    for (QNetworkReply *reply : cancelled) {
+        if (reply->isRunning())
+            reply->abort();
+    }
+}
+
+// Re-route result callbacks through the context's event loop, timing them
+// there for getThreadStats().
+void ApiHandler::bindCallbacksTo(ApiRequest &req, QObject *context)
+{
+    const QPointer<QObject> guard(context);
+    if (req.onResult) {
+        const ApiResultCallback callback = req.onResult;
+        req.onResult = [this, guard, callback](const ApiResult &result) {
+            if (guard)
+                QMetaObject::invokeMethod(guard.data(), [this, callback, result]() {
+                    const qint64 startUs = nowUs();
+                    callback(result);
+                    m_callerUs += quint64(nowUs() - startUs);
+                }, Qt::QueuedConnection);
+        };
+    }
+    if (req.onElement) {
+        const ApiElementCallback callback = req.onElement;
+        req.onElement = [this, guard, callback](const QString &key, const QJsonValue &value) {
+            if (guard)
+                QMetaObject::invokeMethod(guard.data(), [this, callback, key, value]() {
+                    const qint64 startUs = nowUs();
+                    callback(key, value);
+                    m_callerUs += quint64(nowUs() - startUs);
+                }, Qt::QueuedConnection);
+        };
+    }
+}
+
 void ApiHandler::enqueueRequest(const ApiRequest &req)
 {
-    std::lock_guard<std::mutex> lock(m_queueMutex);
-    // Enforce queue size limit: if queue is full, remove the lowest-priority request.
-    if (m_requestQueue.size() >= m_maxQueueSize) {
-        int lowestPriority = std::numeric_limits<int>::max();
-        int removeIndex = -1;
-        for (int i = 0; i < m_requestQueue.size(); ++i) {
-            if (m_requestQueue.at(i).priority < lowestPriority) {
-                lowestPriority = m_requestQueue.at(i).priority;
-                removeIndex = i;
+    enqueueRequest(ApiRequest(req));
+}
+
+void ApiHandler::enqueueRequest(ApiRequest &&req)
+{
+    if (QThread::currentThread() != thread()) {
+        submitRequest(std::move(req));
+        return;
+    }
+    // Keyed once; retries and hedges carry the keys along.
+    if (req.metricsKey.isEmpty()) {
+        req.endpoint = endpointKey(req.url);
+        req.metricsKey = QString::fromLatin1(methodVerb(req.method)) + QLatin1Char(' ') + req.endpoint;
+    }
+    // Mutations to one endpoint run one at a time, in order, unless told
+    // otherwise; writes to other endpoints, e.g. behind a throttled config
+    // POST, do not wait on them.
+    if (req.orderingKey.isEmpty() && req.method != ApiRequest::GET)
+        req.orderingKey = QStringLiteral("mutation ") + req.endpoint;
+    req.lane = laneFor(req);
+
+    // A retry still holds its ordering key; one that goes no further
+    // hands it on.
+    if (req.cancelToken.isCancelled()) {
+        ++m_cancelStats.cancelledQueued;
+        settleJournal(req);
+        if (req.retryCount > 0)
+            releaseOrderingKey(req.orderingKey);
+        return;
+    }
+    if (req.deadline.hasExpired()) {
+        ++m_cancelStats.expiredQueued;
+        settleJournal(req);
+        if (req.retryCount > 0)
+            releaseOrderingKey(req.orderingKey);
+        dropRequest(req, QStringLiteral("Deadline exceeded"));
+        return;
+    }
+    if (req.retryCount == 0 && serveFromCache(req))
+        return;
+    if (m_circuitState != CircuitClosed && m_circuitPolicy == FailFast) {
+        if (req.retryCount > 0)
+            releaseOrderingKey(req.orderingKey);
+        dropRequest(req, QStringLiteral("Syncthing is unreachable"));
+        return;
+    }
+    int position = -1;
+    if (!req.coalesceKey.isEmpty() && !replaceQueued(req, position))
+        return;
+    // Join an identical GET that is already queued or on the wire.
+    if (isCoalescable(req) && req.retryCount == 0) {
+        auto pending = m_pendingGets.find(req.url);
+        if (pending != m_pendingGets.end()) {
+            pending->append(std::move(req.onResult));
+            ++m_coalescedCount;
+            qDebug() << "Request coalesced:" << req.url.toString();
+            return;
+        }
+    }
+
+    RequestLane &lane = m_lanes[req.lane];
+    // A full lane only ever sheds its own traffic.
+    if (lane.size() >= lane.capacity) {
+        // With nothing but parked requests there is no oldest to give up.
+        if (lane.policy == RejectNewest || lane.queue.isEmpty()) {
+            ++lane.stats.rejected;
+            recordEviction(req);
+            qDebug() << "Rejected request, lane full:" << req.url.toString();
+            emit globalError(QString("Rejected request %1, queue lane is full")
+                             .arg(req.url.toString()));
+            settleJournal(req);
+            if (req.retryCount > 0)
+                releaseOrderingKey(req.orderingKey);
+            dropRequest(req, QStringLiteral("Rejected, queue lane is full"));
+            return;
+        }
+        ApiRequest *removed = takeQueued(lane, 0);
+        --m_queuedCount;
+        ++lane.stats.evicted;
+        recordEviction(*removed);
+        qDebug() << "Evicted oldest request:" << removed->url.toString();
+        emit globalError(QString("Removed request %1 due to queue limit")
+                         .arg(removed->url.toString()));
+        settleJournal(*removed);
+        dropRequest(*removed, QStringLiteral("Removed due to queue limit"));
+        m_requestPool.release(removed);
+    }
+    // Journaled once, when first accepted; retries keep their entry.
+    if (m_journal && req.journalId == 0 && !req.journalIntent.isEmpty()
+            && req.method != ApiRequest::GET) {
+        if (req.url.path() == QLatin1String(CONFIG))
+            qCDebug(SyncthingJournalLog) << "Not journaling a full-config write:" << req.journalIntent;
+        else
+            req.journalId = m_journal->record(req);
+    }
+    if (isCoalescable(req) && !m_pendingGets.contains(req.url))
+        m_pendingGets.insert(req.url, QList<ApiResultCallback>());
+    req.enqueuedAtUs = nowUs();
+    req.throttledAtUs = 0;
+    // Reads must not be answered from before a write they queue behind.
+    if (req.method != ApiRequest::GET)
+        invalidateCache(req.url);
+    // Withdraw it on time even when nothing else wakes the queue.
+    if (!req.deadline.isForever())
+        scheduleTimer(m_clock.elapsed() + req.deadline.remainingTime(), WheelTimer());
+    ApiRequest *node = m_requestPool.acquire(std::move(req));
+    // A lane holds one request per ordering key; later ones wait their turn.
+    // A retry still holds its key.
+    const QString &orderingKey = node->orderingKey;
+    if (!orderingKey.isEmpty() && node->retryCount == 0
+            && m_heldOrderingKeys.contains(orderingKey)) {
+        m_parked[orderingKey].enqueue(node);
+        ++lane.parked;
+    } else {
+        if (!orderingKey.isEmpty())
+            m_heldOrderingKeys.insert(orderingKey);
+        if (position >= 0)
+            lane.queue.insert(qMin(position, lane.queue.size()), node);  // The superseded one's place.
+        else if (node->retryCount > 0)
+            lane.queue.prepend(node);  // Ahead of later same-key work.
+        else
+            lane.queue.enqueue(node);
+    }
+    ++lane.stats.enqueued;
+    ++m_queuedCount;
+    emit queueSizeChanged(m_queuedCount);
+    qDebug() << "Request enqueued. New queue size:" << m_queuedCount;
+    scheduleDispatch();
+}
+
+// A keyed request takes over the queued slot of its key, keeping its place
+// in line when both share a lane: the superseded request is taken out and
+// `position` says where it stood (-1 when there is no such slot). Its caller
+// hears it was superseded unless it was withdrawn already. Returns false
+// when `req` is a retry, which loses to whatever is already queued.
+bool ApiHandler::replaceQueued(ApiRequest &req, int &position)
+{
+    position = -1;
+    RequestLane *lane = nullptr;
+    QQueue<ApiRequest*> *queue = nullptr;
+    int index = -1;
+    for (int l = 0; l < ApiRequest::LaneCount && !queue; ++l) {
+        for (int i = 0; i < m_lanes[l].queue.size(); ++i) {
+            if (m_lanes[l].queue.at(i)->coalesceKey == req.coalesceKey) {
+                lane = &m_lanes[l];
+                queue = &lane->queue;
+                index = i;
+                break;
             }
         }
-        if (removeIndex != -1) {
-            ApiRequest removed = m_requestQueue.takeAt(removeIndex);
-            qDebug() << "Removed low priority request:" << removed.url.toString()
-                     << "with priority:" << removed.priority;
-            emit globalError(QString("Removed request %1 due to low priority")
-                             .arg(removed.url.toString()));
-            emit queueSizeChanged(m_requestQueue.size());
+    }
+    for (auto parked = m_parked.begin(); parked != m_parked.end() && !queue; ++parked) {
+        for (int i = 0; i < parked->size(); ++i) {
+            if (parked->at(i)->coalesceKey == req.coalesceKey) {
+                queue = &*parked;
+                index = i;
+                break;
+            }
         }
     }
-    m_requestQueue.enqueue(req);
-    emit queueSizeChanged(m_requestQueue.size());
-    qDebug() << "Request enqueued. New queue size:" << m_requestQueue.size();
+    if (!queue)
+        return true;
+    ++m_supersededCount;
+    if (req.retryCount > 0) {
+        qDebug() << "Retry superseded by a newer request:" << req.url.toString();
+        settleJournal(req);
+        releaseOrderingKey(req.orderingKey);
+        dropSuperseded(req);
+        return false;
+    }
+    ApiRequest *node = nullptr;
+    if (lane) {
+        node = takeQueued(*lane, index);
+        if (node->lane == req.lane)
+            position = index;
+    } else {
+        node = queue->takeAt(index);
+        --m_lanes[node->lane].parked;
+        if (queue->isEmpty())
+            m_parked.remove(node->orderingKey);
+    }
+    qDebug() << "Request superseded:" << node->url.toString();
+    if (isWithdrawn(*node)) {
+        withdrawQueued(node);
+        return true;
+    }
+    --m_queuedCount;
+    settleJournal(*node);
+    dropSuperseded(*node);
+    m_requestPool.release(node);
+    return true;
 }
 
 int ApiHandler::getQueueSize() const {
-    return m_requestQueue.size();
+    return m_queuedCount;
+}
+
+int ApiHandler::getInFlightCount() const {
+    return m_inFlight.size();
+}
+
+quint64 ApiHandler::getCoalescedCount() const {
+    return m_coalescedCount;
+}
+
+quint64 ApiHandler::getSupersededCount() const {
+    return m_supersededCount;
+}
+
+// Only result-style GETs can share a reply; raw callbacks each read their own.
+// A cancel token or deadline belongs to one caller, so those never share;
+// keyed requests already collapse by key instead.
+bool ApiHandler::isCoalescable(const ApiRequest &req)
+{
+    return req.method == ApiRequest::GET && req.onResult && !req.callback && !req.onElement
+            && !req.cancelToken.isValid() && req.deadline.isForever() && req.coalesceKey.isEmpty()
+            && req.unchangedKey.isEmpty();
+}
+
+ApiResult ApiHandler::makeResult(QNetworkReply *reply, const InFlight &flight, bool parse)
+{
+    ApiResult result;
+    result.error = reply->error();
+    if (result.error != QNetworkReply::NoError)
+        result.errorString = reply->errorString();
+    result.httpStatus = reply->attribute(QNetworkRequest::HttpStatusCodeAttribute).toInt();
+    if ((!readBody(reply, flight, result.body) || (flight.decoder && !flight.decoder->finish()))
+            && result.error == QNetworkReply::NoError) {
+        result.error = QNetworkReply::UnknownContentError;
+        result.errorString = flight.decoder->errorString();
+        result.body.clear();
+    }
+    if (parse)
+        parseResult(result);
+    return result;
+}
+
+// Read what the reply has buffered, undoing its Content-Encoding when we
+// offered one. Returns false once the encoded data turns out corrupt.
+bool ApiHandler::readBody(QNetworkReply *reply, const InFlight &flight, QByteArray &body)
+{
+    if (!flight.decoder) {
+        body += reply->readAll();
+        return true;
+    }
+    ContentDecoder &decoder = *flight.decoder;
+    if (!decoder.isStarted() && !decoder.begin(reply->rawHeader("Content-Encoding")))
+        return false;
+    return decoder.decode(reply->readAll(), body);
+}
+
+void ApiHandler::parseResult(ApiResult &result)
+{
+    if (!result.body.isEmpty())
+        result.document = QJsonDocument::fromJson(result.body, &result.parseError);
+}
+
+// Sizes are compared first, so a changed body is usually not even hashed.
+bool ApiHandler::reuseUnchanged(const QString &key, ApiResult &result)
+{
+    auto it = m_lastBodies.constFind(key);
+    if (it == m_lastBodies.constEnd() || it->size != result.body.size()
+            || it->hash != xxHash64(result.body)) {
+        ++m_changeStats.changed;
+        return false;
+    }
+    result.document = it->document;
+    result.notModified = true;
+    ++m_changeStats.unchanged;
+    m_changeStats.skippedBytes += quint64(result.body.size());
+    return true;
+}
+
+void ApiHandler::rememberBody(const QString &key, const ApiResult &result)
+{
+    if (!key.isEmpty() && result.parseError.error == QJsonParseError::NoError)
+        m_lastBodies.insert(key, BodyDigest{xxHash64(result.body), result.body.size(), result.document});
+}
+
+// Hand a large body to the decode pool. The node stays checked out until
+// the parsed result comes back to this thread. Returns false when the body
+// should be parsed here instead.
+bool ApiHandler::offloadDecode(ApiRequest *node, ApiResult &result, quint64 cacheGeneration)
+{
+    if (m_decodeMinBytes <= 0 || result.body.size() < m_decodeMinBytes)
+        return false;
+    if (m_decodeStats.pending >= m_maxPendingDecodes) {
+        ++m_decodeStats.inlined;
+        return false;
+    }
+    ++m_decodeStats.pending;
+    ++m_decodeStats.offloaded;
+    m_decoding.insert(node);
+    m_decodePool->start([this, node, result = std::move(result), cacheGeneration]() mutable {
+        parseResult(result);
+        QMetaObject::invokeMethod(this, [this, node, result = std::move(result), cacheGeneration]() {
+            finishDecode(node, result, cacheGeneration);
+        }, Qt::QueuedConnection);
+    });
+    return true;
+}
+
+void ApiHandler::finishDecode(ApiRequest *node, const ApiResult &result, quint64 cacheGeneration)
+{
+    --m_decodeStats.pending;
+    m_decoding.remove(node);
+    rememberBody(node->unchangedKey, result);
+    if (node->cancelToken.isCancelled())
+        ++m_cancelStats.cancelledInFlight;
+    else
+        storeAndDeliver(*node, result, cacheGeneration);
+    m_requestPool.release(node);
+    // Decode capacity is free again.
+    scheduleDispatch();
+}
+
+// Only keep results that no write could have overtaken.
+void ApiHandler::storeAndDeliver(const ApiRequest &req, const ApiResult &result, quint64 cacheGeneration)
+{
+    const int ttl = cacheTtlFor(req);
+    if (ttl > 0 && cacheGeneration == m_cacheGeneration && !writePendingFor(req.url)) {
+        CacheEntry &entry = m_cache[req.url];
+        entry.result = result;
+        entry.result.notModified = false;  // Only true for this request's key.
+        entry.expiresAtMs = m_clock.elapsed() + ttl;
+    }
+    deliverResult(req, result);
+}
+
+// Feed whatever has arrived to the request's parser. Error bodies are left
+// alone so they still reach onResult; a malformed stream aborts the reply.
+void ApiHandler::feedStream(QNetworkReply *reply)
+{
+    auto it = m_inFlight.find(reply);
+    if (it == m_inFlight.end() || it->streamFailed)
+        return;
+    const int status = reply->attribute(QNetworkRequest::HttpStatusCodeAttribute).toInt();
+    if (status < 200 || status >= 300)
+        return;
+    // Element callbacks run inside feed(); hold the parser and look the
+    // flight up again afterwards.
+    const QSharedPointer<JsonStreamParser> stream = it->stream;
+    const qint64 startUs = nowUs();
+    QByteArray chunk;
+    const bool decoded = readBody(reply, *it, chunk);
+    const bool ok = decoded && stream->feed(chunk);
+    it = m_inFlight.find(reply);
+    if (it == m_inFlight.end())
+        return;
+    it->streamUs += nowUs() - startUs;
+    if (!ok) {
+        it->streamFailed = true;
+        qWarning() << "Streamed reply rejected:"
+                   << (decoded ? it->stream->errorString() : it->decoder->errorString()) << it->req->url;
+        reply->abort();
+    }
+}
+
+ApiResult ApiHandler::finishStream(QNetworkReply *reply, const InFlight &flight)
+{
+    ApiResult result;
+    result.error = reply->error();
+    result.httpStatus = reply->attribute(QNetworkRequest::HttpStatusCodeAttribute).toInt();
+    JsonStreamParser &parser = *flight.stream;
+    QByteArray rest;
+    const bool decoded = flight.streamFailed || result.error != QNetworkReply::NoError
+            || (readBody(reply, flight, rest) && (!flight.decoder || flight.decoder->finish()));
+    if (!decoded) {
+        result.error = QNetworkReply::UnknownContentError;
+        result.errorString = flight.decoder->errorString();
+    } else if (flight.streamFailed
+            || (result.error == QNetworkReply::NoError && !(parser.feed(rest) && parser.finish()))) {
+        result.error = QNetworkReply::UnknownContentError;
+        result.errorString = parser.errorString();
+    } else if (result.error != QNetworkReply::NoError) {
+        result.errorString = reply->errorString();
+        readBody(reply, flight, result.body);
+    }
+    return result;
+}
+
+// Hand one result to the request's own callback and to every GET that
+// coalesced onto it. Waiters are detached first so callbacks can enqueue
+// a fresh request for the same URL.
+void ApiHandler::deliverResult(const ApiRequest &req, const ApiResult &result)
+{
+    QList<ApiResultCallback> waiters;
+    if (isCoalescable(req))
+        waiters = m_pendingGets.take(req.url);
+    if (req.onResult)
+        req.onResult(result);
+    for (const ApiResultCallback &waiter : waiters)
+        waiter(result);
+}
+
+// Fail a request that will never reach the wire. Delivery is deferred to the
+// event loop so callbacks never run in the middle of queue bookkeeping.
+void ApiHandler::dropRequest(const ApiRequest &req, const QString &reason, bool superseded)
+{
+    if (!req.onResult)
+        return;
+    QMetaObject::invokeMethod(this, [this, req, reason, superseded]() {
+        ApiResult result;
+        result.error = QNetworkReply::OperationCanceledError;
+        result.errorString = reason;
+        result.superseded = superseded;
+        deliverResult(req, result);
+    }, Qt::QueuedConnection);
+}
+
+void ApiHandler::dropSuperseded(const ApiRequest &req)
+{
+    dropRequest(req, QStringLiteral("Superseded"), true);
+}
+
+// Collapse per-item paths (e.g. /rest/config/folders/<id>) onto their collection.
+QString ApiHandler::endpointKey(const QUrl &url)
+{
+    const QString path = url.path();
+    for (const QString &collection : {QStringLiteral(CONFIGFOLDER), QStringLiteral(CONFIGDEVICE)}) {
+        if (path.startsWith(collection + '/'))
+            return collection + QStringLiteral("/*");
+    }
+    return path;
+}
+
+QString ApiHandler::endpointKey(const ApiRequest &req)
+{
+    return req.endpoint.isEmpty() ? endpointKey(req.url) : req.endpoint;
+}
+
+bool ApiHandler::canDispatch(const ApiRequest &req) const
+{
+    if (!req.orderingKey.isEmpty() && m_busyOrderingKeys.contains(req.orderingKey))
+        return false;
+    if (!req.coalesceKey.isEmpty() && m_busyCoalesceKeys.contains(req.coalesceKey))
+        return false;
+    const QString key = endpointKey(req);
+    const int limit = m_endpointLimits.value(key, 0);
+    if (limit > 0 && m_endpointInFlight.value(key, 0) >= limit)
+        return false;
+    if (m_rateLimits.isEmpty())
+        return true;
+    auto bucket = m_rateLimits.constFind(timeoutKey(req));
+    return bucket == m_rateLimits.constEnd() || bucket->available(nowUs()) >= 1;
+}
+
+// Called for a queued request canDispatch() refused. If a rate limit is what
+// holds it, start its throttle clock and wake dispatch when a token is due.
+void ApiHandler::noteThrottled(ApiRequest &req)
+{
+    auto bucket = m_rateLimits.constFind(timeoutKey(req));
+    if (bucket == m_rateLimits.constEnd())
+        return;
+    const qint64 now = nowUs();
+    const double available = bucket->available(now);
+    if (available >= 1)
+        return;  // Blocked by something else.
+    if (req.throttledAtUs == 0) {
+        req.throttledAtUs = now;
+        ++m_rateLimitStats.throttled;
+    }
+    const int waitMs = qMax(1, qCeil((1 - available) * 1000 / bucket->rate));
+    if (!m_throttleTimer.isActive() || m_throttleTimer.remainingTime() > waitMs)
+        m_throttleTimer.start(waitMs);
+}
+
+void ApiHandler::takeRateToken(const ApiRequest &req)
+{
+    const QString key = timeoutKey(req);
+    auto bucket = m_rateLimits.find(key);
+    if (bucket != m_rateLimits.end()) {
+        const qint64 now = nowUs();
+        bucket->tokens = bucket->available(now) - 1;
+        bucket->updatedAtUs = now;
+    }
+    if (req.throttledAtUs > 0) {
+        const quint64 waitedUs = quint64(qMax<qint64>(0, nowUs() - req.throttledAtUs));
+        m_rateLimitStats.throttledUs += waitedUs;
+        m_metrics[key].throttledUs.record(waitedUs);
+    }
+}
+
+// Coalesce dispatch requests into a single queued call so a burst of
+// enqueues is handled in one pass once control returns to the event loop.
+void ApiHandler::scheduleDispatch()
+{
+    if (m_dispatchScheduled)
+        return;
+    m_dispatchScheduled = true;
+    QMetaObject::invokeMethod(this, &ApiHandler::processNextRequest, Qt::QueuedConnection);
 }
 
 void ApiHandler::processNextRequest()
 {
-    std::lock_guard<std::mutex> lock(m_queueMutex);
-    if (m_requestInProgress || m_requestQueue.isEmpty())
+    m_dispatchScheduled = false;
+    unparkReleased();
+    dispatchQueued();
+
+    // Keep the fallback sweep running only while requests are waiting.
+    if (m_queuedCount == 0)
+        m_timer.stop();
+    else if (!m_timer.isActive())
+        m_timer.start(m_pollingInterval);
+}
+
+void ApiHandler::dispatchQueued()
+{
+    // While the circuit is not closed only the health probe may go out.
+    if (m_circuitState != CircuitClosed)
+        return;
+    // Decode back-pressure: let the pool catch up before fetching more.
+    if (m_decodeStats.pending >= m_maxPendingDecodes)
         return;
+    ApiRequest *req = nullptr;
+    while (m_inFlight.size() < m_maxInFlight && takeNextRequest(req)) {
+        emit queueSizeChanged(m_queuedCount);
+        sendRequest(req);
+    }
+}
+
+// Weighted round robin over the lanes: each lane may dispatch up to `weight`
+// requests per round. Within a lane the head is normally eligible, so both
+// enqueue and dequeue stay O(1). Requests behind an earlier one with their
+// ordering key are parked rather than queued, so a blocked head (endpoint
+// cap or rate limit) only makes us look past other blocked heads.
+bool ApiHandler::takeNextRequest(ApiRequest *&out)
+{
+    for (int visited = 0; visited <= ApiRequest::LaneCount; ++visited) {
+        RequestLane &lane = m_lanes[m_currentLane];
+        if (lane.credit > 0 && !lane.queue.isEmpty()) {
+            for (int i = 0; i < lane.queue.size(); ++i) {
+                const ApiRequest &candidate = *lane.queue.at(i);
+                if (isWithdrawn(candidate)) {
+                    withdrawQueued(takeQueued(lane, i--));
+                    continue;
+                }
+                if (canDispatch(candidate)) {
+                    out = (i == 0) ? lane.queue.dequeue() : lane.queue.takeAt(i);
+                    --lane.credit;
+                    --m_queuedCount;
+                    ++lane.stats.dispatched;
+                    return true;
+                }
+                if (!m_rateLimits.isEmpty())
+                    noteThrottled(*lane.queue.at(i));
+            }
+        }
+        // Lane exhausted, empty or blocked: move on and refill the next one.
+        m_currentLane = (m_currentLane + 1) % ApiRequest::LaneCount;
+        m_lanes[m_currentLane].credit = m_lanes[m_currentLane].weight;
+    }
+    return false;
+}
 
-    m_requestInProgress = true;
-    ApiRequest req = m_requestQueue.dequeue();
-    emit queueSizeChanged(m_requestQueue.size());
+// A queued request leaving its lane without being sent hands its ordering
+// key on.
+ApiRequest *ApiHandler::takeQueued(RequestLane &lane, int index)
+{
+    ApiRequest *node = lane.queue.takeAt(index);
+    releaseOrderingKey(node->orderingKey);
+    return node;
+}
 
+// The key's holder is done. Its successor is picked at the next dispatch,
+// once a retry has had the chance to take the key back.
+void ApiHandler::releaseOrderingKey(const QString &key)
+{
+    if (key.isEmpty())
+        return;
+    m_busyOrderingKeys.remove(key);
+    m_releasedKeys.insert(key);
+    scheduleDispatch();
+}
+
+// Moves the next parked request of each released key to the head of its
+// lane; it is older than anything queued since.
+void ApiHandler::unparkReleased()
+{
+    const QSet<QString> released = m_releasedKeys;
+    m_releasedKeys.clear();
+    for (const QString &key : released) {
+        if (m_busyOrderingKeys.contains(key))
+            continue;  // Taken back by a retry.
+        ApiRequest *next = nullptr;
+        auto parked = m_parked.find(key);
+        while (!next && parked != m_parked.end() && !parked->isEmpty()) {
+            ApiRequest *node = parked->dequeue();
+            --m_lanes[node->lane].parked;
+            if (isWithdrawn(*node))
+                withdrawQueued(node);
+            else
+                next = node;
+        }
+        if (parked != m_parked.end() && parked->isEmpty())
+            m_parked.erase(parked);
+        if (next)
+            m_lanes[next->lane].queue.prepend(next);
+        else
+            m_heldOrderingKeys.remove(key);
+    }
+}
+
+// Takes over the pooled node; it goes back to the pool once the reply is handled.
+void ApiHandler::sendRequest(ApiRequest *node)
+{
+    const ApiRequest &req = *node;
+    ++m_endpointInFlight[endpointKey(req)];
+    if (!req.orderingKey.isEmpty())
+        m_busyOrderingKeys.insert(req.orderingKey);
+    if (!req.coalesceKey.isEmpty())
+        m_busyCoalesceKeys.insert(req.coalesceKey);
+    if (req.method != ApiRequest::GET)
+        invalidateCache(req.url);
+    if (req.retryCount == 0) {
+        m_retryTokens = qMin(double(m_retryBudgetBurst), m_retryTokens + m_retryBudgetRatio);
+        m_hedgeTokens = qMin(double(m_hedgeBudgetBurst), m_hedgeTokens + m_hedgeBudgetRatio);
+    }
+    if (!m_rateLimits.isEmpty())
+        takeRateToken(req);
+    EndpointMetrics &metrics = m_metrics[timeoutKey(req)];
+    metrics.queueWaitUs.record(quint64(qMax<qint64>(0, nowUs() - req.enqueuedAtUs)));
+    metrics.bytesOut.record(quint64(req.payload.size()));
+
+    bool compressed = false;
+    QNetworkReply *reply = m_transport->send(networkRequestFor(req, compressed),
+                                             methodVerb(req.method), req.payload);
+
+    InFlight &flight = m_inFlight[reply];
+    flight.req = node;
+    flight.cacheGeneration = m_cacheGeneration;
+    flight.sentAtUs = nowUs();
+    if (compressed)
+        flight.decoder = QSharedPointer<ContentDecoder>::create();
+    if (req.onElement) {
+        flight.stream = QSharedPointer<JsonStreamParser>::create(req.onElement, m_streamBufferLimit);
+        connect(reply, &QNetworkReply::readyRead, this, [this, reply]() {
+            feedStream(reply);
+        });
+    }
+    watchReply(reply);
+    if (!m_hedgedEndpoints.isEmpty() && m_hedgedEndpoints.contains(endpointKey(req)))
+        armHedge(reply);
+}
+
+QNetworkRequest ApiHandler::networkRequestFor(const ApiRequest &req, bool &compressed) const
+{
     QNetworkRequest netReq(req.url);
     if (!m_apiKey.isEmpty())
         netReq.setRawHeader("X-API-Key", m_apiKey.toUtf8());
 
-    QNetworkReply *reply = nullptr;
-    switch (req.method) {
-        case ApiRequest::GET:
-            reply = m_networkManager->get(netReq);
-            break;
-        case ApiRequest::POST:
-            netReq.setHeader(QNetworkRequest::ContentTypeHeader, "application/json");
-            reply = m_networkManager->post(netReq, req.payload);
-            break;
-        case ApiRequest::PATCH:
-            netReq.setHeader(QNetworkRequest::ContentTypeHeader, "application/json");
-            reply = m_networkManager->sendCustomRequest(netReq, "PATCH", req.payload);
-            break;
-        case ApiRequest::PUT:
-            netReq.setHeader(QNetworkRequest::ContentTypeHeader, "application/json");
-            reply = m_networkManager->put(netReq, req.payload);
-            break;
-        case ApiRequest::DELETE_:
-            reply = m_networkManager->deleteResource(netReq);
-            break;
-        default:
-            reply = m_networkManager->get(netReq);
-    }
-
-    // Set up a timer to abort the request if it exceeds the timeout limit.
-    QTimer *timeoutTimer = new QTimer(reply);
-    timeoutTimer->setSingleShot(true);
-    connect(timeoutTimer, &QTimer::timeout, reply, [reply, this, req]() {
-        if (reply->isRunning()) {
-            reply->abort();
-            qWarning() << "Request timed out:" << req.url;
-            emit globalError(QString("Request timed out: %1").arg(req.url.toString()));
-        }
+    if (req.method == ApiRequest::POST || req.method == ApiRequest::PATCH
+            || req.method == ApiRequest::PUT)
+        netReq.setHeader(QNetworkRequest::ContentTypeHeader, "application/json");
+    // Asking explicitly also stops QNetworkAccessManager from inflating the
+    // body behind our back, so the wire size stays visible.
+    compressed = !req.callback && !m_compressedEndpoints.isEmpty()
+            && m_compressedEndpoints.contains(endpointKey(req));
+    if (compressed)
+        netReq.setRawHeader("Accept-Encoding", "gzip, deflate");
+    return netReq;
+}
+
+// Abort the reply if it exceeds the endpoint's timeout or runs into its
+// deadline, whichever comes first, and handle it once it finishes.
+void ApiHandler::watchReply(QNetworkReply *reply)
+{
+    InFlight &flight = m_inFlight[reply];
+    const int timeoutMs = timeoutFor(*flight.req);
+    const qint64 remainingMs = flight.req->deadline.remainingTime();
+    WheelTimer timer;
+    timer.kind = remainingMs >= 0 && remainingMs < timeoutMs ? WheelTimer::ReplyDeadline
+                                                             : WheelTimer::ReplyTimeout;
+    timer.reply = reply;
+    timer.timeoutMs = timeoutMs;
+    flight.timer = scheduleTimer(m_clock.elapsed() + (timer.kind == WheelTimer::ReplyDeadline
+                                                      ? remainingMs : timeoutMs), timer);
+    connect(reply, &QNetworkReply::finished, this, [this, reply]() {
+        onReplyFinished(reply);
     });
-    timeoutTimer->start(m_requestTimeoutMs);
+}
+
+ApiHandler::DeadlineWheel::Handle ApiHandler::scheduleTimer(qint64 dueMs, const WheelTimer &timer)
+{
+    const qint64 nowMs = m_clock.elapsed();
+    m_wheel.sync(nowMs);  // File relative to now, not to the last tick processed.
+    const DeadlineWheel::Handle handle = m_wheel.schedule(dueMs, timer);
+    // Deadlines mostly arrive in order, so the timer rarely needs moving.
+    const int waitMs = int(qMax<qint64>(0, m_wheel.nextDueMs() - nowMs));
+    if (!m_wheelTimer.isActive() || m_wheelTimer.remainingTime() > waitMs)
+        m_wheelTimer.start(waitMs);
+    return handle;
+}
 
-    connect(reply, &QNetworkReply::finished, this, [this, reply, req, timeoutTimer]() {
-        timeoutTimer->stop();
-        handleNetworkReply(reply, req);
-        timeoutTimer->deleteLater();
+void ApiHandler::onWheelTick()
+{
+    bool sweep = false;
+    m_wheel.advance(m_clock.elapsed(), [this, &sweep](const WheelTimer &timer) {
+        if (timer.kind == WheelTimer::SweepQueues)
+            sweep = true;
+        else if (timer.kind == WheelTimer::Hedge)
+            sendHedge(timer.reply);
+        else
+            expireReply(timer);
     });
+    // Requests dispatched before their deadline leave a stale sweep behind.
+    if (sweep && m_queuedCount > 0)
+        sweepWithdrawn();
+    const qint64 dueMs = m_wheel.nextDueMs();
+    if (dueMs >= 0)
+        m_wheelTimer.start(int(qMax<qint64>(0, dueMs - m_clock.elapsed())));
+}
+
+// Entries for a reply are cancelled once it leaves m_inFlight, so `reply`
+// is still alive here.
+void ApiHandler::expireReply(const WheelTimer &timer)
+{
+    QNetworkReply *reply = timer.reply;
+    auto it = m_inFlight.find(reply);
+    if (it == m_inFlight.end() || !reply->isRunning())
+        return;
+    it->timer = 0;
+    const QUrl url = it->req->url;
+    if (timer.kind == WheelTimer::ReplyDeadline) {
+        it->expired = true;
+        qWarning() << "Request deadline exceeded:" << url;
+    } else {
+        it->timedOut = true;
+        qWarning() << "Request timed out after" << timer.timeoutMs << "ms:" << url;
+        emit globalError(QString("Request timed out: %1").arg(url.toString()));
+    }
+    reply->abort();  // May finish the reply, and erase `it`, synchronously.
 }
 
-void ApiHandler::handleNetworkReply(QNetworkReply *reply, const ApiRequest &req)
+void ApiHandler::onReplyFinished(QNetworkReply *reply)
 {
-    if (reply->error() != QNetworkReply::NoError) {
+    auto it = m_inFlight.find(reply);
+    if (it == m_inFlight.end()) {
+        reply->deleteLater();  // The losing copy of a hedged GET.
+        return;
+    }
+    const InFlight flight = *it;
+    m_inFlight.erase(it);
+    m_wheel.cancel(flight.timer);
+    m_wheel.cancel(flight.hedgeTimer);
+    auto other = flight.partner ? m_inFlight.find(flight.partner) : m_inFlight.end();
+    if (other != m_inFlight.end()) {
+        other->partner = nullptr;
+        if (reply->error() != QNetworkReply::NoError) {
+            // The other copy may still succeed; it answers for both.
+            reply->deleteLater();
+            scheduleDispatch();
+            return;
+        }
+        // First good answer wins. Write the other copy off before aborting
+        // it, since abort() may finish it synchronously.
+        QNetworkReply *loser = other.key();
+        m_wheel.cancel(other->timer);
+        m_wheel.cancel(other->hedgeTimer);
+        m_inFlight.erase(other);
+        if (flight.isHedge)
+            ++m_hedgeStats.won;
+        else
+            ++m_hedgeStats.lost;
+        loser->abort();
+    }
+    handleNetworkReply(reply, flight);
+}
+
+// A GET still outstanding at its endpoint's p95 gets a second copy.
+void ApiHandler::armHedge(QNetworkReply *reply)
+{
+    static const quint64 MinSamples = 20;  // Too few round trips make a poor p95.
+    const ApiRequest &req = *m_inFlight.value(reply).req;
+    if (req.method != ApiRequest::GET || req.callback || req.onElement)
+        return;
+    auto metrics = m_metrics.constFind(timeoutKey(req));
+    if (metrics == m_metrics.constEnd() || metrics->wireUs.count() < MinSamples)
+        return;
+    WheelTimer timer;
+    timer.kind = WheelTimer::Hedge;
+    timer.reply = reply;
+    m_inFlight[reply].hedgeTimer = scheduleTimer(
+            m_clock.elapsed() + qMax<qint64>(1, qint64(metrics->wireUs.percentile(95) / 1000)), timer);
+}
+
+void ApiHandler::sendHedge(QNetworkReply *original)
+{
+    auto it = m_inFlight.find(original);
+    if (it == m_inFlight.end())
+        return;
+    it->hedgeTimer = 0;
+    if (!original->isRunning() || it->partner
+            || it->cancelled || it->expired || it->timedOut)
+        return;
+    if (m_hedgeTokens < 1.0) {
+        ++m_hedgeStats.deniedByBudget;
+        return;
+    }
+    m_hedgeTokens -= 1.0;
+    ++m_hedgeStats.sent;
+    const ApiRequest &req = *it->req;
+    qDebug() << "Hedging slow request:" << req.url.toString();
+    bool compressed = false;
+    QNetworkReply *hedge = m_transport->send(networkRequestFor(req, compressed),
+                                             methodVerb(req.method), req.payload);
+    InFlight copy;
+    copy.req = it->req;
+    copy.cacheGeneration = it->cacheGeneration;
+    // Time the pair from the original's send: a winning hedge must not feed
+    // a short sample back into the timeout and the p95 that arms hedging.
+    copy.sentAtUs = it->sentAtUs;
+    copy.partner = original;
+    copy.isHedge = true;
+    if (compressed)
+        copy.decoder = QSharedPointer<ContentDecoder>::create();
+    it->partner = hedge;
+    m_inFlight.insert(hedge, copy);
+    watchReply(hedge);
+}
+
+QByteArray ApiHandler::methodVerb(ApiRequest::HttpMethod method)
+{
+    static const char *const methodNames[] = { "GET", "POST", "PATCH", "PUT", "DELETE" };
+    return QByteArray(methodNames[method]);
+}
+
+QString ApiHandler::timeoutKey(const ApiRequest &req)
+{
+    if (!req.metricsKey.isEmpty())
+        return req.metricsKey;
+    return QString::fromLatin1(methodVerb(req.method)) + QLatin1Char(' ') + endpointKey(req.url);
+}
+
+int ApiHandler::timeoutFor(const ApiRequest &req) const
+{
+    auto it = m_timeouts.constFind(timeoutKey(req));
+    if (it == m_timeouts.constEnd())
+        return qBound(m_minTimeoutMs, m_requestTimeoutMs, m_maxTimeoutMs);
+    return it->timeoutMs;
+}
+
+// RFC 6298 style estimator: smoothed RTT plus four deviations, clamped to
+// the configured bounds.
+void ApiHandler::recordRoundTrip(const ApiRequest &req, qint64 rttMs)
+{
+    EndpointTimeout &est = m_timeouts[timeoutKey(req)];
+    const double sample = double(rttMs);
+    if (est.samples == 0) {
+        est.smoothedRttMs = sample;
+        est.rttVarianceMs = sample / 2;
+    } else {
+        est.rttVarianceMs = 0.75 * est.rttVarianceMs + 0.25 * qAbs(est.smoothedRttMs - sample);
+        est.smoothedRttMs = 0.875 * est.smoothedRttMs + 0.125 * sample;
+    }
+    ++est.samples;
+    est.timeoutMs = qBound(m_minTimeoutMs,
+                           int(est.smoothedRttMs + 4 * est.rttVarianceMs),
+                           m_maxTimeoutMs);
+}
+
+// A timeout doubles the endpoint's timeout until a clean sample arrives.
+void ApiHandler::backOffTimeout(const ApiRequest &req)
+{
+    const QString key = timeoutKey(req);
+    const int current = timeoutFor(req);
+    EndpointTimeout &est = m_timeouts[key];
+    est.timeoutMs = qMin(m_maxTimeoutMs, current * 2);
+}
+
+void ApiHandler::handleNetworkReply(QNetworkReply *reply, const InFlight &flight)
+{
+    const ApiRequest &req = *flight.req;
+    const QString key = endpointKey(req);
+    if (--m_endpointInFlight[key] <= 0)
+        m_endpointInFlight.remove(key);
+    releaseOrderingKey(req.orderingKey);
+    if (!req.coalesceKey.isEmpty())
+        m_busyCoalesceKeys.remove(req.coalesceKey);
+
+    if (flight.timedOut)
+        backOffTimeout(req);
+    else if (reply->error() == QNetworkReply::NoError && req.retryCount == 0)
+        recordRoundTrip(req, (nowUs() - flight.sentAtUs) / 1000); // Karn: skip retried requests.
+
+    if (isConnectionFailure(reply->error()))
+        recordConnectionFailure();
+    else if (reply->error() == QNetworkReply::NoError)
+        m_consecutiveFailures = 0;
+
+    const QString metricsKey = timeoutKey(req);
+    {
+        EndpointMetrics &metrics = m_metrics[metricsKey];
+        metrics.wireUs.record(quint64(nowUs() - flight.sentAtUs));
+        if (flight.timedOut)
+            ++metrics.timeouts;
+    }
+    const qint64 handlingStartUs = nowUs();
+    const qint64 unreadBytes = reply->bytesAvailable();
+    const ApiResult streamed = flight.stream ? finishStream(reply, flight) : ApiResult();
+    bool decoding = false;  // The node now belongs to a pending decode.
+    if (flight.cancelled || req.cancelToken.isCancelled()) {
+        // The caller has moved on: no callbacks, no retry.
+        ++m_cancelStats.cancelledInFlight;
+        settleJournal(req);
+    } else if (flight.expired) {
+        ++m_cancelStats.expiredInFlight;
+        settleJournal(req);
+        ApiResult result;
+        result.error = QNetworkReply::OperationCanceledError;
+        result.errorString = QStringLiteral("Deadline exceeded");
+        deliverResult(req, result);
+    } else if (reply->error() != QNetworkReply::NoError || !streamed.ok()) {
         if(reply->error() == QNetworkReply::ConnectionRefusedError){
         emit connectionError();
             }
-        qWarning() << "Syncthing request failed to" << req.url << ":" << reply->errorString();
+        qWarning() << "Syncthing request failed to" << req.url << ":"
+                   << (flight.stream ? streamed.errorString : reply->errorString());
 
-        retryRequest(req);
+        // Elements already handed out cannot be taken back by a replay.
+        const bool replayable = !flight.stream
+                || (!flight.streamFailed && flight.stream->elementCount() == 0);
+        if (!replayable || !retryRequest(req)) {
+            // A daemon that answered with an error will answer the same again.
+            if (reply->attribute(QNetworkRequest::HttpStatusCodeAttribute).toInt() != 0
+                    || req.cancelToken.isCancelled())
+                settleJournal(req);
+            deliverResult(req, flight.stream ? streamed : makeResult(reply, flight));
+        }
     }  else {
-        if (req.callback)
+        settleJournal(req);
+        if (req.method != ApiRequest::GET)
+            invalidateCache(req.url);
+        if (req.callback) {
             req.callback(reply);
+        } else if (flight.stream) {
+            deliverResult(req, streamed);
+        } else if (req.onResult) {
+            ApiResult result = makeResult(reply, flight, false);
+            if (!result.ok())
+                deliverResult(req, result);  // Undecodable body.
+            else if (!req.unchangedKey.isEmpty() && reuseUnchanged(req.unchangedKey, result))
+                storeAndDeliver(req, result, flight.cacheGeneration);
+            else
+                decoding = offloadDecode(flight.req, result, flight.cacheGeneration);
+            if (result.ok() && !decoding && !result.notModified) {
+                parseResult(result);
+                rememberBody(req.unchangedKey, result);
+                storeAndDeliver(req, result, flight.cacheGeneration);
+            }
+        }
         emit requestProcessed(QString("Request to %1 processed successfully").arg(req.url.toString()));
     }
+    // Callbacks may have added endpoints, so look the entry up again.
+    {
+        EndpointMetrics &metrics = m_metrics[metricsKey];
+        metrics.callbackUs.record(quint64(nowUs() - handlingStartUs + flight.streamUs));
+        // The decoder has seen the whole body by now, unless nobody read it.
+        const bool decoded = flight.decoder && flight.decoder->bytesIn() > 0;
+        const qint64 bodyBytes = flight.stream ? flight.stream->bytesFed()
+                               : decoded ? flight.decoder->bytesOut() : unreadBytes;
+        metrics.bytesIn.record(quint64(bodyBytes));
+        metrics.wireBytesIn.record(quint64(decoded ? flight.decoder->bytesIn() : bodyBytes));
+    }
+    ++m_repliesHandled;
+    m_handlerUs += quint64(nowUs() - handlingStartUs + flight.streamUs);
+    if (!decoding)
+        m_requestPool.release(flight.req);
     reply->deleteLater();
-    m_requestInProgress = false;
+    // A slot is free now; start the next request without waiting for a tick.
+    scheduleDispatch();
 }
 
-void ApiHandler::retryRequest(ApiRequest req)
+// Errors that mean the daemon itself is unreachable, as opposed to a slow
+// or failing individual request.
+bool ApiHandler::isConnectionFailure(QNetworkReply::NetworkError error)
 {
-    if (req.retryCount < m_maxRetries) {
-        req.retryCount++;
-        qWarning() << "Retrying request to" << req.url << "(Attempt" << req.retryCount << ")";
-        enqueueRequest(req);
-    } else {
+    switch (error) {
+    case QNetworkReply::ConnectionRefusedError:
+    case QNetworkReply::RemoteHostClosedError:
+    case QNetworkReply::HostNotFoundError:
+    case QNetworkReply::TemporaryNetworkFailureError:
+        return true;
+    default:
+        return false;
+    }
+}
+
+void ApiHandler::recordConnectionFailure()
+{
+    if (m_circuitState == CircuitClosed && ++m_consecutiveFailures >= m_circuitThreshold)
+        openCircuit();
+}
+
+void ApiHandler::setCircuitState(CircuitState state)
+{
+    if (m_circuitState == state)
+        return;
+    m_circuitState = state;
+    qDebug() << "Circuit breaker state changed to" << state;
+    emit circuitStateChanged(state);
+}
+
+void ApiHandler::openCircuit()
+{
+    setCircuitState(CircuitOpen);
+    qWarning() << "Syncthing unreachable, probing again in" << m_circuitOpenMs << "ms";
+    if (m_circuitPolicy == FailFast)
+        failQueuedRequests(QStringLiteral("Syncthing is unreachable"));
+    QTimer::singleShot(m_circuitOpenMs, this, &ApiHandler::probeDaemon);
+}
+
+// Half-open: a single cheap health call decides whether traffic resumes.
+void ApiHandler::probeDaemon()
+{
+    setCircuitState(CircuitHalfOpen);
+    ApiRequest probe;
+    probe.method = ApiRequest::GET;
+    probe.url = m_baseUrl;
+    probe.url.setPath(QString(HEALTH));
+    QNetworkReply *reply = m_transport->send(QNetworkRequest(probe.url), methodVerb(probe.method),
+                                             QByteArray());
+    QTimer::singleShot(timeoutFor(probe), reply, [reply]() {
+        if (reply->isRunning())
+            reply->abort();
+    });
+    connect(reply, &QNetworkReply::finished, this, [this, reply]() {
+        reply->deleteLater();
+        if (reply->error() == QNetworkReply::NoError) {
+            m_consecutiveFailures = 0;
+            m_circuitOpenMs = m_circuitBaseOpenMs;
+            setCircuitState(CircuitClosed);
+            scheduleDispatch();
+        } else {
+            m_circuitOpenMs = qMin(m_circuitMaxOpenMs, m_circuitOpenMs * 2);
+            openCircuit();
+        }
+    });
+}
+
+void ApiHandler::failQueuedRequests(const QString &reason)
+{
+    for (RequestLane &lane : m_lanes) {
+        while (!lane.queue.isEmpty()) {
+            ApiRequest *removed = takeQueued(lane, 0);
+            dropRequest(*removed, reason);
+            m_requestPool.release(removed);
+            --m_queuedCount;
+        }
+        lane.parked = 0;
+    }
+    for (const QQueue<ApiRequest*> &parked : m_parked) {
+        for (ApiRequest *removed : parked) {
+            dropRequest(*removed, reason);
+            m_requestPool.release(removed);
+            --m_queuedCount;
+        }
+    }
+    m_parked.clear();
+    emit queueSizeChanged(m_queuedCount);
+}
+
+// Schedule a retry after an exponential backoff with full jitter, as long as
+// the method's policy and the global retry budget allow it.
+bool ApiHandler::retryRequest(ApiRequest req)
+{
+    if (m_circuitState != CircuitClosed && m_circuitPolicy == FailFast)
+        return false;
+    if (req.cancelToken.isCancelled())
+        return false;
+    const RetryPolicy &policy = m_retryPolicies[req.method];
+    if (req.retryCount >= policy.maxRetries) {
+        ++m_retryStats.exhausted;
         qCritical() << "Max retries reached for" << req.url;
         emit globalError(QString("Max retries reached for request to %1").arg(req.url.toString()));
+        return false;
     }
+    if (m_retryTokens < 1.0) {
+        ++m_retryStats.deniedByBudget;
+        qWarning() << "Retry budget exhausted, giving up on" << req.url;
+        emit globalError(QString("Retry budget exhausted for request to %1").arg(req.url.toString()));
+        return false;
+    }
+    const qint64 ceiling = qMin<qint64>(policy.maxDelayMs,
+                                        qint64(policy.baseDelayMs) << qMin(req.retryCount, 20));
+    const int delayMs = int(QRandomGenerator::global()->bounded(ceiling + 1));
+    // A retry that would only fire past the deadline is not worth a token.
+    const qint64 remainingMs = req.deadline.remainingTime();
+    if (remainingMs >= 0 && remainingMs <= delayMs) {
+        ++m_cancelStats.expiredQueued;
+        qWarning() << "Not retrying" << req.url << "past its deadline";
+        return false;
+    }
+    m_retryTokens -= 1.0;
+    req.retryCount++;
+    qWarning() << "Retrying request to" << req.url << "(Attempt" << req.retryCount << ") in"
+               << delayMs << "ms";
+    ++m_retryStats.scheduled;
+    ++m_retryStats.pending;
+    ++m_metrics[timeoutKey(req)].retries;
+    // Later requests with the same ordering key wait for the retry; it goes
+    // back in at the head of its lane.
+    if (!req.orderingKey.isEmpty())
+        m_busyOrderingKeys.insert(req.orderingKey);
+    QTimer::singleShot(delayMs, this, [this, req]() mutable {
+        --m_retryStats.pending;
+        if (!req.orderingKey.isEmpty())
+            m_busyOrderingKeys.remove(req.orderingKey);
+        enqueueRequest(std::move(req));
+    });
+    return true;
 }
 
 void ApiHandler::onTimerTick()
 {
+    sweepWithdrawn();
     processNextRequest();
 }
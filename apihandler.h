@@ -3,48 +3,336 @@
 
 #include <QObject>
 #include <QQueue>
+#include <QHash>
+#include <QSet>
+#include <QVector>
 #include <QNetworkAccessManager>
 #include <QNetworkReply>
 #include <QTimer>
+#include <QElapsedTimer>
+#include <QDeadlineTimer>
 #include <QUrl>
+#include <QJsonDocument>
+#include <QSharedPointer>
+#include <QThread>
+#include <QThreadPool>
 #include <functional>
-#include <mutex>
+#include <atomic>
+#include <memory>
 #include <QLoggingCategory>
+#include "apitransport.h"
+#include "histogram.h"
+#include "timerwheel.h"
+#include "mpscqueue.h"
+#include "endpoints.h"
 
 // Declare a logging category.
 Q_DECLARE_LOGGING_CATEGORY(SyncthingHandlerLog)
 
+// Outcome of a request. The body is read and parsed once, and the same
+// immutable result is handed to every callback waiting on it.
+struct ApiResult {
+    QNetworkReply::NetworkError error = QNetworkReply::NoError;
+    QString errorString;
+    int httpStatus = 0;
+    QByteArray body;
+    QJsonDocument document;        // Null when the body is empty or not JSON.
+    QJsonParseError parseError{};
+    // The body matched the last one under the request's unchangedKey, and
+    // `document` is the one parsed from that.
+    bool notModified = false;
+    // A newer request with the same coalesceKey took this one's place before
+    // it was sent. Reported as OperationCanceledError; periodic probes
+    // usually just ignore it.
+    bool superseded = false;
+
+    bool ok() const { return error == QNetworkReply::NoError; }
+};
+using ApiResultCallback = std::function<void(const ApiResult&)>;
+// Receives one streamed element; see JsonStreamParser for what an element is.
+using ApiElementCallback = std::function<void(const QString &key, const QJsonValue &value)>;
+
+class JsonStreamParser;
+class ContentDecoder;
+class RequestJournal;
+class ApiCall;
+
+// Shared handle that withdraws every request carrying it. Copies share one
+// flag and cancel() may be called from any thread; a default-constructed
+// token never cancels anything. ApiHandler::cancel() also aborts requests
+// that are already on the wire.
+class ApiCancelToken
+{
+public:
+    static ApiCancelToken create();
+    bool isValid() const { return bool(m_cancelled); }
+    bool isCancelled() const { return m_cancelled && m_cancelled->load(); }
+    void cancel() const;
+
+private:
+    std::shared_ptr<std::atomic<bool>> m_cancelled;
+};
+
 // Structure representing a Syncthing API request.
 struct ApiRequest {
     enum HttpMethod { GET, POST, PATCH, PUT, DELETE_ } method;
+    // QoS lanes, served by weighted round robin with separate bounds.
+    enum Lane { AutoLane = -1, ControlLane, StateLane, TelemetryLane, LaneCount };
     QUrl url;
     QByteArray payload;
     std::function<void(QNetworkReply*)> callback;
-    int priority = 1;      // Default priority.
+    // Alternative to `callback`: receives the parsed reply, also when the
+    // request finally fails. Identical GETs using it share one round trip.
+    ApiResultCallback onResult;
+    // Streams the reply instead: elements are parsed and delivered while the
+    // body is still arriving, and onResult only reports how it ended (with an
+    // empty body). A stream that has delivered elements is never retried.
+    ApiElementCallback onElement;
+    Lane lane = AutoLane;  // Derived from method and endpoint when left on Auto.
     int retryCount = 0;    // Times this request has been retried.
+    QString orderingKey;   // Requests sharing a key run one at a time, in order.
+    // Latest wins: a newer request with the same key replaces the queued one,
+    // and only one per key is on the wire. Meant for periodic probes.
+    QString coalesceKey;
+    // A reply byte-for-byte identical to the last one under this key skips
+    // parsing and comes back notModified. Meant for periodic polls: give
+    // each poller its own key, so it only misses changes it has seen.
+    QString unchangedKey;
+    ApiCancelToken cancelToken;  // Cancelled requests run no callbacks at all.
+    // Absolute deadline. Past it the request is dropped or aborted, and
+    // onResult receives OperationCanceledError; it is never retried beyond it.
+    QDeadlineTimer deadline = QDeadlineTimer(QDeadlineTimer::Forever);
+    qint64 enqueuedAtUs = 0;  // Set by ApiHandler when the request is queued.
+    qint64 throttledAtUs = 0; // Set by ApiHandler when a rate limit first holds it back.
+    // Set by ApiHandler when the request is queued, so per-endpoint lookups
+    // share these instead of rebuilding them: the path with per-item paths
+    // collapsed onto their collection, and "METHOD endpoint".
+    QString endpoint;
+    QString metricsKey;
+    // What a mutation is for, e.g. "accept folder abc". When set and a
+    // journal is open, the request is journaled until it is answered or
+    // given up on, and replayed on the next start if neither happens.
+    // Only for writes that apply a delta: a replayed full-config POST would
+    // overwrite whatever changed in between, so those are never journaled.
+    QString journalIntent;
+    quint64 journalId = 0;    // Set by ApiHandler once journaled.
 };
 
 class ApiHandler : public QObject
 {
     Q_OBJECT
 public:
+    // What a full lane does with new work.
+    enum OverflowPolicy { DropOldest, RejectNewest };
+    // Circuit breaker guarding against an unreachable daemon.
+    enum CircuitState { CircuitClosed, CircuitOpen, CircuitHalfOpen };
+    Q_ENUM(CircuitState)
+    // What happens to requests while the circuit is open.
+    enum CircuitPolicy { ParkRequests, FailFast };
+    struct CacheStats {
+        quint64 hits = 0;
+        quint64 misses = 0;
+        quint64 invalidations = 0;  // Entries dropped by a related write.
+        int entries = 0;
+    };
+    // Timeout derived from an endpoint's observed round trips.
+    struct EndpointTimeout {
+        int timeoutMs = 0;
+        double smoothedRttMs = 0;
+        double rttVarianceMs = 0;
+        int samples = 0;
+    };
+    // How failed requests of one HTTP method are retried.
+    struct RetryPolicy {
+        int maxRetries = 1;
+        int baseDelayMs = 100;   // Backoff cap for the first retry; doubles per attempt.
+        int maxDelayMs = 5000;
+    };
+    struct RetryStats {
+        quint64 scheduled = 0;
+        quint64 deniedByBudget = 0;
+        quint64 exhausted = 0;   // Requests that used up their retries.
+        int pending = 0;         // Retries waiting out their backoff.
+    };
+    struct LaneStats {
+        quint64 enqueued = 0;
+        quint64 dispatched = 0;
+        quint64 evicted = 0;   // Queued requests dropped to make room.
+        quint64 rejected = 0;  // New requests refused by a full lane.
+        int queued = 0;
+    };
+    // Work saved by cancellation tokens and deadlines.
+    struct CancelStats {
+        quint64 cancelledQueued = 0;    // Withdrawn before reaching the wire.
+        quint64 cancelledInFlight = 0;  // Aborted on the wire, callbacks skipped.
+        quint64 expiredQueued = 0;      // Dropped, or not retried, past the deadline.
+        quint64 expiredInFlight = 0;    // Aborted on the wire at the deadline.
+    };
+    // Per-endpoint measurements, keyed like getEndpointTimeouts().
+    struct EndpointMetrics {
+        Histogram queueWaitUs;   // Enqueue to dispatch.
+        Histogram wireUs;        // Dispatch to reply finished.
+        Histogram callbackUs;    // Reply handling, parsing and callbacks.
+        Histogram bytesIn;       // Response body size, decoded.
+        Histogram wireBytesIn;   // Response body as received, still compressed.
+        Histogram bytesOut;      // Request body size.
+        Histogram throttledUs;   // Time held back by a rate limit, throttled requests only.
+        quint64 retries = 0;
+        quint64 timeouts = 0;
+        quint64 evictions = 0;   // Requests shed by a full queue lane.
+    };
+    // Requests held back by rate limits; see setRateLimit().
+    struct RateLimitStats {
+        quint64 throttled = 0;    // Requests that had to wait for a token.
+        quint64 throttledUs = 0;  // Their total wait, enqueue order aside.
+    };
+    // Second copies of slow GETs; see setHedging().
+    struct HedgeStats {
+        quint64 sent = 0;
+        quint64 won = 0;            // The copy answered first: hedging helped.
+        quint64 lost = 0;           // The original answered first anyway.
+        quint64 deniedByBudget = 0;
+    };
+    struct JournalStats {
+        quint64 recorded = 0;
+        quint64 settled = 0;
+        quint64 commits = 0;    // fsyncs; recorded / commits is the group size.
+        int open = 0;           // Entries not settled yet.
+    };
+    // Replies to requests with an unchangedKey.
+    struct ChangeStats {
+        quint64 unchanged = 0;
+        quint64 changed = 0;
+        quint64 skippedBytes = 0;   // Bodies that were not parsed again.
+    };
+    struct DecodeStats {
+        quint64 offloaded = 0;   // Bodies parsed on the decode pool.
+        quint64 inlined = 0;     // Parsed here because the pool was saturated.
+        int pending = 0;         // Decodes not yet delivered.
+    };
+    // Where reply handling time goes. With the worker thread running,
+    // handlerUs is work the caller's (UI) thread no longer does.
+    struct ThreadStats {
+        quint64 replies = 0;
+        quint64 handlerUs = 0;   // Reply handling on ApiHandler's thread.
+        quint64 callerUs = 0;    // Bound callbacks run on their callers' threads.
+    };
+
     static ApiHandler* getInstance(); // Singleton instance.
     ApiHandler(const ApiHandler&) = delete;
     ApiHandler& operator=(const ApiHandler&) = delete;
     ~ApiHandler();
 
-    // Setters.
+    // Move ApiHandler, its transport and timers onto a dedicated thread with
+    // its own event loop. Call once, from the thread that owns it, before
+    // other threads use it; the thread is stopped when the application quits.
+    void startWorkerThread();
+    bool isWorkerThreadRunning() const;
+
+    // Setters. Safe from any thread: off-thread calls are queued to
+    // ApiHandler's thread, in order.
     void setApiKey(const QString &apiKey);
     void setBaseUrl(const QUrl &baseUrl);
-    void setRetryCount(int maxRetries);
-    void setQueueLimit(int limit);         // Limit for the queue size.
-    void setRequestTimeout(int timeoutMs); // Timeout for individual requests.
+    // Prebuilt absolute URL of an endpoint; copying it does not allocate.
+    // Readable from any thread once the base URL is set at start-up.
+    const QUrl &endpointUrl(Endpoint endpoint) const;
+    // URL of one item of a collection endpoint, e.g. a folder by ID.
+    QUrl endpointUrl(Endpoint endpoint, const QString &item) const;
+    // Replace how requests reach the daemon. Takes ownership of the transport.
+    void setTransport(ApiTransport *transport);
+    void setRetryCount(int maxRetries);    // Same retry limit for every method.
+    void setRetryPolicy(ApiRequest::HttpMethod method, const RetryPolicy &policy);
+    // Retries may use at most `ratio` of first attempts, with `burst` saved up.
+    void setRetryBudget(double ratio, int burst);
+    // Open after `failureThreshold` consecutive connection failures; probe
+    // after openMs, doubling up to maxOpenMs while the daemon stays down.
+    void setCircuitBreaker(int failureThreshold, int openMs, int maxOpenMs);
+    void setCircuitPolicy(CircuitPolicy policy);
+    void setQueueLimit(int limit);         // Capacity of the state lane, at least 1.
+    void setLaneConfig(ApiRequest::Lane lane, int capacity, int weight, OverflowPolicy policy);
+    void setRequestTimeout(int timeoutMs); // Initial timeout for endpoints without samples.
+    void setTimeoutBounds(int floorMs, int ceilingMs); // Clamp for adaptive timeouts.
+    void setMaxInFlight(int maxInFlight);  // Requests allowed on the wire at once.
+    void setRequestPoolLimit(int nodes);   // Spare request nodes kept for reuse; 0 keeps none.
+    // Cap concurrent requests to one endpoint path (0 removes the cap).
+    void setEndpointInFlightLimit(const QString &path, int limit);
+    // Token bucket for one method on one endpoint path: `ratePerSecond`
+    // requests on average, up to `burst` at once (a rate of 0 removes it).
+    // Requests over the limit wait in their lane rather than being dropped.
+    void setRateLimit(ApiRequest::HttpMethod method, const QString &path,
+                      double ratePerSecond, int burst);
+    // Serve repeat result-style GETs to an endpoint from memory for ttlMs
+    // (0 disables). Any write to a related path invalidates the entries.
+    void setCacheTtl(const QString &path, int ttlMs);
+    void clearCache();
+    // Hedge GETs to an endpoint path, which must be safe to send twice: one
+    // still outstanding after the endpoint's observed p95 gets a second copy,
+    // and the first answer wins while the other is aborted. Streamed and raw
+    // `callback` requests are never hedged.
+    void setHedging(const QString &path, bool enabled);
+    // Hedges may add at most `ratio` of first attempts, with `burst` saved up.
+    void setHedgeBudget(double ratio, int burst);
+    // Offer gzip/deflate for result-style replies from an endpoint path and
+    // decode them here, streamed replies as they arrive. Raw `callback`
+    // requests are never offered compression: they read the reply themselves.
+    void setCompression(const QString &path, bool enabled);
+    // Largest single element a streamed reply may buffer before it is aborted.
+    void setStreamBufferLimit(int bytes);
+    // Parse result bodies of at least minBytes on a worker pool instead of
+    // this thread (0 disables). At most maxPending decodes are outstanding:
+    // past that no new requests are dispatched and replies that still arrive
+    // are parsed here, so the backlog stays bounded.
+    void setDecodeOffload(int minBytes, int maxPending = 4);
+    // Open a write-ahead journal for requests with a journalIntent and
+    // replay what it still holds from the last run. Call once, after the
+    // base URL is set; replayed requests have no callbacks of their own.
+    // Entries older than maxAgeSecs are discarded instead of replayed.
+    void setJournal(const QString &path, int maxAgeSecs = 24 * 3600);
+    // The next reply under `unchangedKey` counts as changed, e.g. because
+    // acting on the last one failed and it should be offered again.
+    void forgetUnchanged(const QString &unchangedKey);
 
-    // Enqueue an API request.
+    // Enqueue an API request. Safe from any thread; off-thread calls are
+    // forwarded to submitRequest() with the calling thread as the context.
     void enqueueRequest(const ApiRequest &req);
+    void enqueueRequest(ApiRequest &&req);  // Moves the request into the queue.
+    // Thread-safe, lock-free submission. The request is handed to
+    // ApiHandler's own thread, which does all network work. onResult and
+    // onElement run in the event loop of `context`'s thread, or of the
+    // calling thread when no context is given (and are dropped if the
+    // context is destroyed first). Raw `callback`s always run in
+    // ApiHandler's thread. Inspection getters, unlike setters, must be
+    // called from ApiHandler's thread.
+    void submitRequest(ApiRequest req, QObject *context = nullptr);
+    // Awaitable requests for coroutine flows; see apicoroutine.h.
+    ApiCall send(ApiRequest req);
+    ApiCall get(const QUrl &url);
+    ApiCall post(const QUrl &url, const QByteArray &payload);
+    ApiCall put(const QUrl &url, const QByteArray &payload);
+    // Cancel the token and withdraw its requests, queued or in flight.
+    // Safe from any thread.
+    void cancel(const ApiCancelToken &token);
 
     // For testing or inspection.
     int getQueueSize() const;
+    int getInFlightCount() const;
+    LaneStats getLaneStats(ApiRequest::Lane lane) const;
+    quint64 getCoalescedCount() const;     // GETs served by another in-flight GET.
+    quint64 getSupersededCount() const;    // Keyed requests replaced by a newer one.
+    CacheStats getCacheStats() const;
+    // Current timeouts keyed by "METHOD /path".
+    QHash<QString, EndpointTimeout> getEndpointTimeouts() const;
+    RetryStats getRetryStats() const;
+    CircuitState getCircuitState() const;
+    CancelStats getCancelStats() const;
+    QHash<QString, EndpointMetrics> getEndpointMetrics() const;
+    void resetEndpointMetrics();
+    ThreadStats getThreadStats() const;    // Safe from any thread.
+    DecodeStats getDecodeStats() const;
+    ChangeStats getChangeStats() const;
+    RateLimitStats getRateLimitStats() const;
+    JournalStats getJournalStats() const;
+    HedgeStats getHedgeStats() const;
 
     QUrl m_baseUrl;                     // Base URL for Syncthing requests.
 signals:
@@ -56,29 +344,241 @@ signals:
     void queueSizeChanged(int size);
 
     void connectionError();
+    // Emitted when the circuit breaker changes state.
+    void circuitStateChanged(ApiHandler::CircuitState state);
 
 public slots:
     // Process the next request in the queue.
     void processNextRequest();
     // Timer event to check the queue.
     void onTimerTick();
-    // Retry a failed request.
-    void retryRequest(ApiRequest req);
+    // Retry a failed request. Returns false once retries are exhausted.
+    bool retryRequest(ApiRequest req);
 
 private:
     explicit ApiHandler(QObject *parent = nullptr);
-    void handleNetworkReply(QNetworkReply *reply, const ApiRequest &req);
+    void drainSubmissions();
+    bool replaceQueued(ApiRequest &req, int &position);
+    static bool isWithdrawn(const ApiRequest &req);
+    void withdrawQueued(ApiRequest *node);
+    void sweepWithdrawn();
+    void bindCallbacksTo(ApiRequest &req, QObject *context);
+    // Re-invoke a setter on ApiHandler's thread when called from another.
+    template <typename Fn>
+    bool postToOwnThread(Fn &&fn)
+    {
+        if (QThread::currentThread() == thread())
+            return false;
+        QMetaObject::invokeMethod(this, std::forward<Fn>(fn), Qt::QueuedConnection);
+        return true;
+    }
+    void scheduleDispatch();
+    void dispatchQueued();
+    void sendRequest(ApiRequest *node);
+    QNetworkRequest networkRequestFor(const ApiRequest &req, bool &compressed) const;
+    void watchReply(QNetworkReply *reply);
+    void onReplyFinished(QNetworkReply *reply);
+    void armHedge(QNetworkReply *reply);
+    void sendHedge(QNetworkReply *original);
+
+    // What the timer wheel fires. Requests never get a QTimer of their own.
+    struct WheelTimer {
+        enum Kind { SweepQueues, ReplyTimeout, ReplyDeadline, Hedge } kind = SweepQueues;
+        QNetworkReply *reply = nullptr;
+        int timeoutMs = 0;
+    };
+    typedef TimerWheel<WheelTimer> DeadlineWheel;
+    DeadlineWheel::Handle scheduleTimer(qint64 dueMs, const WheelTimer &timer);
+    void onWheelTick();
+    void expireReply(const WheelTimer &timer);
+
+    // Bookkeeping for a request on the wire.
+    struct InFlight {
+        ApiRequest *req = nullptr;  // Pooled node, released once handled.
+        quint64 cacheGeneration = 0;
+        qint64 sentAtUs = 0;
+        qint64 streamUs = 0;     // Time spent parsing and delivering streamed elements.
+        bool timedOut = false;
+        bool expired = false;       // Aborted at the request's deadline.
+        bool cancelled = false;     // Aborted through its cancel token.
+        QSharedPointer<JsonStreamParser> stream; // Set for streamed replies.
+        QSharedPointer<ContentDecoder> decoder;  // Set when compression was offered.
+        QNetworkReply *partner = nullptr;  // The other copy of a hedged GET.
+        bool isHedge = false;       // This is the second copy; `req` is shared.
+        DeadlineWheel::Handle timer = 0;        // Timeout or deadline.
+        DeadlineWheel::Handle hedgeTimer = 0;
+        bool streamFailed = false;
+    };
+
+    void handleNetworkReply(QNetworkReply *reply, const InFlight &flight);
+    static QByteArray methodVerb(ApiRequest::HttpMethod method);
+    static QString timeoutKey(const ApiRequest &req);
+    int timeoutFor(const ApiRequest &req) const;
+    void recordRoundTrip(const ApiRequest &req, qint64 rttMs);
+    void backOffTimeout(const ApiRequest &req);
+    static bool isConnectionFailure(QNetworkReply::NetworkError error);
+    void recordConnectionFailure();
+    void setCircuitState(CircuitState state);
+    void openCircuit();
+    void probeDaemon();
+    void failQueuedRequests(const QString &reason);
+    void deliverResult(const ApiRequest &req, const ApiResult &result);
+    void settleJournal(const ApiRequest &req);
+    qint64 nowUs() const;
+    void recordEviction(const ApiRequest &req);
+    void dropRequest(const ApiRequest &req, const QString &reason, bool superseded = false);
+    void dropSuperseded(const ApiRequest &req);
+    static ApiResult makeResult(QNetworkReply *reply, const InFlight &flight, bool parse = true);
+    static bool readBody(QNetworkReply *reply, const InFlight &flight, QByteArray &body);
+    static void parseResult(ApiResult &result);
+    bool reuseUnchanged(const QString &key, ApiResult &result);
+    void rememberBody(const QString &key, const ApiResult &result);
+    bool offloadDecode(ApiRequest *node, ApiResult &result, quint64 cacheGeneration);
+    void finishDecode(ApiRequest *node, const ApiResult &result, quint64 cacheGeneration);
+    void storeAndDeliver(const ApiRequest &req, const ApiResult &result, quint64 cacheGeneration);
+    void feedStream(QNetworkReply *reply);
+    static ApiResult finishStream(QNetworkReply *reply, const InFlight &flight);
+    static bool isCoalescable(const ApiRequest &req);
+    int cacheTtlFor(const ApiRequest &req) const;
+    bool serveFromCache(const ApiRequest &req);
+    void invalidateCache(const QUrl &writtenUrl);
+    static bool isConfigPath(const QString &path);
+    bool writePendingFor(const QUrl &readUrl) const;
+    bool takeNextRequest(ApiRequest *&out);
+    bool canDispatch(const ApiRequest &req) const;
+    void noteThrottled(ApiRequest &req);
+    void takeRateToken(const ApiRequest &req);
+    static ApiRequest::Lane laneFor(const ApiRequest &req);
+    static QString endpointKey(const QUrl &url);
+    static QString endpointKey(const ApiRequest &req);
+
+    // Free list of request nodes, so queueing a request reuses storage
+    // instead of allocating one per request.
+    class RequestPool {
+    public:
+        ~RequestPool();
+        ApiRequest *acquire(ApiRequest &&req);
+        void release(ApiRequest *req);
+        void setMaxFree(int maxFree);
+    private:
+        int m_maxFree = 64;
+        QVector<ApiRequest*> m_free;
+    };
+
+    // Refills continuously at `rate` tokens per second, up to `burst`.
+    struct TokenBucket {
+        double rate = 0;
+        double burst = 1;
+        double tokens = 1;
+        qint64 updatedAtUs = 0;
 
-    QQueue<ApiRequest> m_requestQueue; // Request queue.
-    std::mutex m_queueMutex;            // Protects the queue.
-    bool m_requestInProgress;           // Indicates if a request is in flight.
-    QNetworkAccessManager *m_networkManager; // Used for network calls.
+        double available(qint64 nowUs) const
+        {
+            return qMin(burst, tokens + (nowUs - updatedAtUs) * rate / 1e6);
+        }
+    };
+
+    struct RequestLane {
+        QQueue<ApiRequest*> queue;
+        int capacity = 20;
+        int weight = 1;        // Dispatches per round-robin turn.
+        int credit = 0;        // Dispatches left in the current turn.
+        OverflowPolicy policy = DropOldest;
+        LaneStats stats;
+        int parked = 0;        // Requests of this lane waiting in m_parked.
+
+        int size() const { return queue.size() + parked; }
+    };
+
+    ApiRequest *takeQueued(RequestLane &lane, int index);
+    void releaseOrderingKey(const QString &key);
+    void unparkReleased();
+
+    RequestLane m_lanes[ApiRequest::LaneCount]; // Request queues, one per lane.
+    int m_queuedCount;                  // Requests waiting across all lanes.
+    int m_currentLane;                  // Lane currently being served.
+    QHash<QNetworkReply*, InFlight> m_inFlight; // Requests currently on the wire.
+    int m_maxInFlight;                  // Concurrency window.
+    QHash<QString, int> m_endpointLimits;   // Per-endpoint in-flight caps.
+    QHash<QString, int> m_endpointInFlight; // Per-endpoint in-flight counts.
+    QSet<QString> m_busyOrderingKeys;       // Ordering keys on the wire or awaiting a retry.
+    // Ordering keys taken by a request that is queued, on the wire or
+    // awaiting a retry. Later requests with a taken key wait in m_parked, in
+    // order, so a lane holds at most one request per key.
+    QSet<QString> m_heldOrderingKeys;
+    QHash<QString, QQueue<ApiRequest*>> m_parked;
+    QSet<QString> m_releasedKeys;           // Held keys to hand on at the next dispatch.
+    QSet<QString> m_busyCoalesceKeys;       // Coalesce keys with a request in flight.
+    QHash<QString, TokenBucket> m_rateLimits; // Keyed like getEndpointTimeouts().
+    RateLimitStats m_rateLimitStats;
+    ApiTransport *m_transport;          // Used for network calls.
     QString m_apiKey;                   // API key.
-    QTimer m_timer;                     // Timer for polling the queue.
-    int m_maxRetries;                   // Maximum retries for a request.
-    int m_maxQueueSize;                 // Maximum allowed queued requests.
-    int m_pollingInterval;              // Milliseconds between processing attempts.
-    int m_requestTimeoutMs;             // Timeout for individual requests.
+    QTimer m_timer;                     // Fallback timer while requests wait.
+    QTimer m_throttleTimer;             // Wakes dispatch when the next token is due.
+    DeadlineWheel m_wheel;              // Timeouts and deadlines of every request.
+    QTimer m_wheelTimer;                // Drives m_wheel, armed for its next due tick.
+    RetryPolicy m_retryPolicies[ApiRequest::DELETE_ + 1]; // Retry settings per method.
+    int m_maxQueueSize;                 // Default per-lane queue bound.
+    int m_pollingInterval;              // Milliseconds between fallback queue sweeps.
+    int m_requestTimeoutMs;             // Initial timeout for unseen endpoints.
+    bool m_dispatchScheduled;           // A queued dispatch pass is pending.
+    QHash<QUrl, QList<ApiResultCallback>> m_pendingGets; // Extra waiters per coalesced GET.
+    quint64 m_coalescedCount;           // GETs that joined one already pending.
+    quint64 m_supersededCount;          // Keyed requests a newer one replaced.
+
+    struct CacheEntry {
+        ApiResult result;
+        qint64 expiresAtMs = 0;
+    };
+    QHash<QUrl, CacheEntry> m_cache;    // Fresh GET results by URL.
+    QHash<QString, int> m_cacheTtls;    // Per-endpoint freshness windows.
+    quint64 m_cacheGeneration;          // Bumped by every write; stale GETs are not stored.
+    CacheStats m_cacheStats;
+    QElapsedTimer m_clock;              // Monotonic time base.
+    QHash<QString, EndpointTimeout> m_timeouts; // Adaptive timeouts per method and endpoint.
+    int m_minTimeoutMs;                 // Floor for adaptive timeouts.
+    int m_maxTimeoutMs;                 // Ceiling for adaptive timeouts.
+    double m_retryTokens;               // Retry budget currently available.
+    double m_retryBudgetRatio;          // Tokens earned per first attempt.
+    int m_retryBudgetBurst;             // Most tokens that can be saved up.
+    RetryStats m_retryStats;
+    CircuitState m_circuitState;
+    CircuitPolicy m_circuitPolicy;
+    int m_consecutiveFailures;          // Connection failures since the last success.
+    int m_circuitThreshold;             // Failures that open the circuit.
+    int m_circuitBaseOpenMs;            // First wait before probing.
+    int m_circuitMaxOpenMs;             // Longest wait before probing.
+    int m_circuitOpenMs;                // Current wait before probing.
+    int m_streamBufferLimit;            // Per-element cap for streamed replies.
+    QSet<QString> m_compressedEndpoints;    // Endpoint keys offered gzip/deflate.
+    struct BodyDigest {
+        quint64 hash = 0;
+        int size = 0;
+        QJsonDocument document;
+    };
+    QHash<QString, BodyDigest> m_lastBodies;    // Last good reply per unchangedKey.
+    ChangeStats m_changeStats;
+    QSet<QString> m_hedgedEndpoints;        // Endpoint keys whose GETs may be hedged.
+    double m_hedgeTokens;                   // Hedging budget currently available.
+    double m_hedgeBudgetRatio;              // Tokens earned per first attempt.
+    int m_hedgeBudgetBurst;
+    HedgeStats m_hedgeStats;
+    QHash<QString, EndpointMetrics> m_metrics; // Observability per method and endpoint.
+    MpscQueue<ApiRequest> m_submissions;    // Requests handed over from any thread.
+    std::atomic<bool> m_drainScheduled;     // A queued drainSubmissions() is pending.
+    RequestPool m_requestPool;
+    EndpointUrls m_endpoints;               // Endpoint URLs for the current base URL.
+    CancelStats m_cancelStats;
+    QThread *m_workerThread;                // Set by startWorkerThread().
+    std::atomic<quint64> m_repliesHandled;
+    std::atomic<quint64> m_handlerUs;       // See ThreadStats.
+    std::atomic<quint64> m_callerUs;
+    QThreadPool *m_decodePool;              // Created by setDecodeOffload().
+    QSet<ApiRequest*> m_decoding;           // Nodes checked out to the decode pool.
+    int m_decodeMinBytes;                   // 0: always parse on this thread.
+    int m_maxPendingDecodes;
+    DecodeStats m_decodeStats;
+    RequestJournal *m_journal;              // Set by setJournal().
 };
 
 #endif // APIHANDLER_H
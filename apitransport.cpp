@@ -0,0 +1,21 @@
+#include "apitransport.h"
+
+NetworkManagerTransport::NetworkManagerTransport(QObject *parent)
+    : ApiTransport(parent),
+      m_manager(new QNetworkAccessManager(this))
+{
+}
+
+QNetworkReply *NetworkManagerTransport::send(const QNetworkRequest &request, const QByteArray &verb,
+                                             const QByteArray &body)
+{
+    if (verb == "GET")
+        return m_manager->get(request);
+    if (verb == "POST")
+        return m_manager->post(request, body);
+    if (verb == "PUT")
+        return m_manager->put(request, body);
+    if (verb == "DELETE")
+        return m_manager->deleteResource(request);
+    return m_manager->sendCustomRequest(request, verb, body);
+}
@@ -0,0 +1,38 @@
+#ifndef APITRANSPORT_H
+#define APITRANSPORT_H
+
+#include <QObject>
+#include <QNetworkAccessManager>
+#include <QNetworkReply>
+#include <QNetworkRequest>
+
+// Moves ApiHandler's requests to the daemon. A transport hands back a
+// QNetworkReply that emits finished() exactly once and can be aborted, so
+// ApiHandler does not care how the bytes travel.
+class ApiTransport : public QObject
+{
+    Q_OBJECT
+public:
+    explicit ApiTransport(QObject *parent = nullptr) : QObject(parent) {}
+    virtual ~ApiTransport() = default;
+
+    // Send `verb` with `body` to the request's URL. The caller owns the reply.
+    virtual QNetworkReply *send(const QNetworkRequest &request, const QByteArray &verb,
+                                const QByteArray &body) = 0;
+};
+
+// Default transport backed by QNetworkAccessManager.
+class NetworkManagerTransport : public ApiTransport
+{
+    Q_OBJECT
+public:
+    explicit NetworkManagerTransport(QObject *parent = nullptr);
+
+    QNetworkReply *send(const QNetworkRequest &request, const QByteArray &verb,
+                        const QByteArray &body) override;
+
+private:
+    QNetworkAccessManager *m_manager;
+};
+
+#endif // APITRANSPORT_H
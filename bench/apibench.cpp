@@ -0,0 +1,593 @@
+// Throughput benchmark for ApiHandler, run against FakeSyncthingServer in
+// the same process.
+//
+//     apibench [--requests=N] [--concurrency=K] [--threads=N] [--flows=N]
+//              [--latency=ms] [--jitter=ms] [--errors=rate] [--drops=rate]
+//              [--padding=bytes] [--devices=N] [--folders=N] [--events=N]
+//              [--compress] [--rate=req/s] [--polls=N]
+//              [--threaded]
+//              [--scenarios=get-qnam,get-http,get-copy,threads,paced,polls,flows]
+//
+// Scenarios:
+//   get-qnam  closed-loop GETs through QNetworkAccessManager
+//   get-http  the same through HttpTransport (pipelined keep-alive)
+//   get-copy  get-http with requests built the way they were before endpoint
+//             descriptors: the base URL copied and its path set from the
+//             urlbase.h macro, the request copied into the handler, and no
+//             pooled nodes. Run with get-http, it prints the allocations
+//             per request saved
+//   threads   closed loops on several threads, all using submitRequest()
+//   paced     open loop at --rate GETs per second (default 10000), each with
+//             a deadline, through HttpTransport; shows what tracking
+//             timeouts and deadlines costs per request
+//   polls     the manager's poll cycle (pending devices and folders, and
+//             connections) with unchangedKey, then without as polls-raw;
+//             the cpu column is per cycle
+//   flows     SyncthingManager flows; HOME is pointed at a scratch config.xml
+//
+// CPU time and allocations are for the whole process, so they include the
+// fake server's share of every request.
+
+#include "fakesyncthing.h"
+#include "../apihandler.h"
+#include "../httptransport.h"
+#include "../histogram.h"
+#include "../syncthingmanager.h"
+#include "../urlbase.h"
+#include <QCoreApplication>
+#include <QDebug>
+#include <QDir>
+#include <QElapsedTimer>
+#include <QEventLoop>
+#include <QFile>
+#include <QJsonObject>
+#include <QTemporaryDir>
+#include <QThread>
+#include <QTimer>
+#include <QUrlQuery>
+#include <atomic>
+#include <cstdio>
+#include <cstdlib>
+#include <ctime>
+#include <new>
+
+// Every heap allocation in the process, Qt's included.
+static std::atomic<quint64> g_allocations{0};
+
+void *operator new(std::size_t size)
+{
+    g_allocations.fetch_add(1, std::memory_order_relaxed);
+    if (void *p = std::malloc(size ? size : 1))
+        return p;
+    throw std::bad_alloc();
+}
+
+void operator delete(void *p) noexcept
+{
+    std::free(p);
+}
+
+void operator delete(void *p, std::size_t) noexcept
+{
+    std::free(p);
+}
+
+namespace {
+
+struct BenchOptions {
+    int requests = 20000;
+    int concurrency = 8;    // Kept below the lane capacity, so nothing is shed.
+    int threads = 4;
+    int flows = 200;
+    int rate = 10000;       // Requests per second for the paced scenario.
+    int polls = 1000;
+    bool threaded = false;  // Run ApiHandler on its worker thread.
+    QStringList scenarios{"get-qnam", "get-http", "get-copy", "threads", "paced", "polls", "flows"};
+    FakeSyncthingConfig server;
+};
+
+// Totals for one scenario.
+struct Sample {
+    quint64 requests = 0;
+    quint64 failures = 0;
+    quint64 retries = 0;
+    double seconds = 0;
+    double cpuSeconds = 0;
+    quint64 allocations = 0;
+    Histogram latencyUs;
+};
+
+// Process-wide counters at the start of a scenario.
+class Meter
+{
+public:
+    explicit Meter(ApiHandler *api) : m_api(api) { restart(); }
+
+    void restart()
+    {
+        m_wall.start();
+        m_cpu = std::clock();
+        m_allocations = g_allocations.load();
+        m_retries = retriesScheduled();
+    }
+
+    void stop(Sample &sample) const
+    {
+        sample.seconds = m_wall.nsecsElapsed() / 1e9;
+        sample.cpuSeconds = double(std::clock() - m_cpu) / CLOCKS_PER_SEC;
+        sample.allocations = g_allocations.load() - m_allocations;
+        sample.retries = retriesScheduled() - m_retries;
+    }
+
+private:
+    quint64 retriesScheduled() const;
+
+    ApiHandler *m_api;
+    QElapsedTimer m_wall;
+    std::clock_t m_cpu;
+    quint64 m_allocations;
+    quint64 m_retries;
+};
+
+// Inspection getters must run on ApiHandler's thread.
+template <typename Fn>
+auto onApiThread(ApiHandler *api, Fn fn) -> decltype(fn())
+{
+    if (api->thread() == QThread::currentThread())
+        return fn();
+    decltype(fn()) value{};
+    QMetaObject::invokeMethod(api, [&value, &fn]() { value = fn(); }, Qt::BlockingQueuedConnection);
+    return value;
+}
+
+quint64 Meter::retriesScheduled() const
+{
+    ApiHandler *api = m_api;
+    return onApiThread(api, [api]() { return api->getRetryStats().scheduled; });
+}
+
+// Keeps `concurrency` GETs outstanding until `total` have finished, from the
+// calling thread's event loop. URLs are unique, so none are coalesced.
+class ClosedLoop
+{
+public:
+    ClosedLoop(ApiHandler *api, const QUrl &url, int total, int concurrency, int firstSeq = 0)
+        : m_api(api), m_url(url), m_total(total), m_concurrency(concurrency), m_seq(firstSeq)
+    {
+    }
+
+    // Builds each URL from the base in `m_url` and `path`, and submits a
+    // copy of the request, as callers did before endpoint descriptors.
+    void buildLikeBefore(const char *path) { m_legacyPath = path; }
+
+    void run(Sample &sample, int timeoutMs = 120000)
+    {
+        m_sample = &sample;
+        m_clock.start();
+        for (int i = 0; i < qMin(m_concurrency, m_total); ++i)
+            issue();
+        QTimer::singleShot(timeoutMs, &m_loop, [this]() {
+            qWarning() << "Closed loop timed out with" << m_total - m_done << "requests outstanding";
+            m_loop.quit();
+        });
+        if (m_done < m_total)
+            m_loop.exec();
+    }
+
+private:
+    void issue()
+    {
+        ++m_issued;
+        QUrl url = m_url;
+        if (m_legacyPath)
+            url.setPath(QString(m_legacyPath));
+        url.setQuery(QStringLiteral("seq=%1").arg(m_seq++));
+        ApiRequest req;
+        req.method = ApiRequest::GET;
+        req.url = url;
+        const qint64 startedNs = m_clock.nsecsElapsed();
+        req.onResult = [this, startedNs](const ApiResult &result) {
+            m_sample->latencyUs.record(quint64((m_clock.nsecsElapsed() - startedNs) / 1000));
+            ++m_sample->requests;
+            if (!result.ok())
+                ++m_sample->failures;
+            if (++m_done == m_total)
+                m_loop.quit();
+            else if (m_issued < m_total)
+                issue();
+        };
+        if (m_legacyPath)
+            m_api->submitRequest(req);
+        else
+            m_api->submitRequest(std::move(req));
+    }
+
+    ApiHandler *m_api;
+    QUrl m_url;
+    int m_total;
+    int m_concurrency;
+    int m_seq;
+    const char *m_legacyPath = nullptr;
+    int m_issued = 0;
+    int m_done = 0;
+    Sample *m_sample = nullptr;
+    QElapsedTimer m_clock;
+    QEventLoop m_loop;
+};
+
+// Issues `total` GETs at a fixed rate, however fast they are answered, from
+// the calling thread's event loop. Latency includes time spent queued.
+class OpenLoop
+{
+public:
+    OpenLoop(ApiHandler *api, const QUrl &url, int total, int rate, int deadlineMs)
+        : m_api(api), m_url(url), m_total(total), m_rate(qMax(1, rate)), m_deadlineMs(deadlineMs)
+    {
+        m_pacer.setTimerType(Qt::PreciseTimer);
+        QObject::connect(&m_pacer, &QTimer::timeout, [this]() { issueDue(); });
+    }
+
+    void run(Sample &sample, int timeoutMs = 120000)
+    {
+        m_sample = &sample;
+        m_clock.start();
+        m_pacer.start(1);
+        QTimer::singleShot(timeoutMs, &m_loop, [this]() {
+            qWarning() << "Open loop timed out with" << m_total - m_done << "requests outstanding";
+            m_loop.quit();
+        });
+        if (m_done < m_total)
+            m_loop.exec();
+        m_pacer.stop();
+    }
+
+private:
+    void issueDue()
+    {
+        const qint64 due = qMin<qint64>(m_total, m_clock.nsecsElapsed() * m_rate / 1000000000);
+        while (m_issued < due)
+            issue();
+        if (m_issued == m_total)
+            m_pacer.stop();
+    }
+
+    void issue()
+    {
+        QUrl url = m_url;
+        url.setQuery(QStringLiteral("seq=%1").arg(m_issued++));
+        ApiRequest req;
+        req.method = ApiRequest::GET;
+        req.url = url;
+        req.deadline = QDeadlineTimer(m_deadlineMs);
+        const qint64 startedNs = m_clock.nsecsElapsed();
+        req.onResult = [this, startedNs](const ApiResult &result) {
+            m_sample->latencyUs.record(quint64((m_clock.nsecsElapsed() - startedNs) / 1000));
+            ++m_sample->requests;
+            if (!result.ok())
+                ++m_sample->failures;
+            if (++m_done == m_total)
+                m_loop.quit();
+        };
+        m_api->submitRequest(std::move(req));
+    }
+
+    ApiHandler *m_api;
+    QUrl m_url;
+    int m_total;
+    int m_rate;
+    int m_deadlineMs;
+    int m_issued = 0;
+    int m_done = 0;
+    Sample *m_sample = nullptr;
+    QElapsedTimer m_clock;
+    QTimer m_pacer;
+    QEventLoop m_loop;
+};
+
+void printHeader()
+{
+    std::printf("%-10s %9s %10s %9s %9s %12s %11s %8s %8s\n", "scenario", "requests", "req/s",
+                "p50(us)", "p99(us)", "cpu/req(us)", "allocs/req", "failed", "retries");
+}
+
+void printSample(const char *name, const Sample &sample, quint64 requests)
+{
+    const double n = qMax<quint64>(requests, 1);
+    std::printf("%-10s %9llu %10.0f %9llu %9llu %12.1f %11.1f %8llu %8llu\n", name,
+                (unsigned long long)requests, requests / qMax(sample.seconds, 1e-9),
+                (unsigned long long)sample.latencyUs.percentile(50),
+                (unsigned long long)sample.latencyUs.percentile(99),
+                sample.cpuSeconds * 1e6 / n, sample.allocations / n,
+                (unsigned long long)sample.failures, (unsigned long long)sample.retries);
+    std::fflush(stdout);
+}
+
+Sample runGet(const char *name, ApiHandler *api, ApiTransport *transport,
+              FakeSyncthingServer &server, const BenchOptions &options, bool likeBefore = false)
+{
+    api->setTransport(transport);
+    const QUrl url = server.baseUrl().resolved(QUrl(QStringLiteral(PING)));
+    if (likeBefore)
+        api->setRequestPoolLimit(0);
+    // Warm up the connections and the request pool outside the measurement.
+    Sample warmup;
+    ClosedLoop(api, url, options.concurrency * 4, options.concurrency).run(warmup);
+
+    Sample sample;
+    Meter meter(api);
+    ClosedLoop loop(api, likeBefore ? server.baseUrl() : url, options.requests, options.concurrency);
+    if (likeBefore)
+        loop.buildLikeBefore(PING);
+    loop.run(sample);
+    meter.stop(sample);
+    printSample(name, sample, sample.requests);
+    if (likeBefore)
+        api->setRequestPoolLimit(64);  // The default.
+    return sample;
+}
+
+// Several threads submitting at once exercise the lock-free submission queue.
+void runThreads(ApiHandler *api, FakeSyncthingServer &server, const BenchOptions &options)
+{
+    const QUrl url = server.baseUrl().resolved(QUrl(QStringLiteral(PING)));
+    const int threads = qMax(1, options.threads);
+    const int perThread = options.requests / threads;
+    const int concurrency = qMax(1, options.concurrency / threads);
+    QVector<Sample> samples(threads);
+    QVector<QThread*> workers;
+
+    Meter meter(api);
+    for (int i = 0; i < threads; ++i) {
+        Sample *sample = &samples[i];
+        QThread *worker = QThread::create([api, url, perThread, concurrency, i, sample]() {
+            ClosedLoop(api, url, perThread, concurrency, i * perThread).run(*sample);
+        });
+        workers.append(worker);
+        worker->start();
+    }
+    // Keep serving the fake daemon while the workers run.
+    for (QThread *worker : workers) {
+        while (!worker->wait(1))
+            QCoreApplication::processEvents();
+        delete worker;
+    }
+    Sample total;
+    meter.stop(total);
+    for (const Sample &sample : samples) {
+        total.requests += sample.requests;
+        total.failures += sample.failures;
+        total.latencyUs.merge(sample.latencyUs);
+    }
+    printSample("threads", total, total.requests);
+}
+
+// A fixed arrival rate rather than a fixed concurrency, so the handler also
+// sees the bursts and backlog that come with it.
+void runPaced(ApiHandler *api, FakeSyncthingServer &server, const BenchOptions &options)
+{
+    api->setTransport(HttpTransport::forTcp(QStringLiteral("127.0.0.1"), server.port()));
+    const QUrl url = server.baseUrl().resolved(QUrl(QStringLiteral(STATUS)));
+    // Room for a backlog, so the rate is not met by shedding requests.
+    api->setLaneConfig(ApiRequest::StateLane, 4096, 2, ApiHandler::DropOldest);
+    api->setMaxInFlight(qMax(4, options.concurrency));
+
+    Sample sample;
+    Meter meter(api);
+    OpenLoop(api, url, options.requests, options.rate, 5000).run(sample);
+    meter.stop(sample);
+    printSample("paced", sample, sample.requests);
+
+    api->setLaneConfig(ApiRequest::StateLane, 20, 2, ApiHandler::DropOldest);  // The defaults.
+    api->setMaxInFlight(4);
+}
+
+// One poll cycle as SyncthingManager runs it: the same three GETs, each
+// walking its document the way the manager's callbacks do unless the body
+// is unchanged. Bodies only change when config does, so the raw run pays
+// for parsing what the keyed run skips.
+void runPolls(const char *name, ApiHandler *api, FakeSyncthingServer &server,
+              const BenchOptions &options, bool unchanged)
+{
+    api->setTransport(HttpTransport::forTcp(QStringLiteral("127.0.0.1"), server.port()));
+    const QString paths[] = {QStringLiteral(PENDINGDEVICE), QStringLiteral(PENDINGFOLDSERS),
+                             QStringLiteral(CONNECTEDDEVICE)};
+    Sample sample;
+    Meter meter(api);
+    QElapsedTimer clock;
+    clock.start();
+    for (int cycle = 0; cycle < options.polls; ++cycle) {
+        QEventLoop loop;
+        int outstanding = 3;
+        const qint64 startedNs = clock.nsecsElapsed();
+        for (const QString &path : paths) {
+            ApiRequest req;
+            req.method = ApiRequest::GET;
+            req.url = server.baseUrl().resolved(QUrl(path));
+            if (unchanged)
+                req.unchangedKey = QStringLiteral("bench-poll ") + path;
+            req.onResult = [&](const ApiResult &result) {
+                if (!result.ok())
+                    ++sample.failures;
+                if (!result.notModified) {
+                    const QJsonObject root = result.document.object();
+                    for (auto it = root.begin(); it != root.end(); ++it)
+                        it.value().toObject().keys();
+                }
+                if (--outstanding == 0)
+                    loop.quit();
+            };
+            api->submitRequest(std::move(req));
+        }
+        if (outstanding > 0)
+            loop.exec();
+        sample.latencyUs.record(quint64((clock.nsecsElapsed() - startedNs) / 1000));
+        ++sample.requests;
+    }
+    meter.stop(sample);
+    printSample(name, sample, sample.requests);
+}
+
+// Waits until ApiHandler has nothing queued or in flight and the server has
+// gone quiet; retries in their backoff keep it busy.
+void waitForIdle(ApiHandler *api, FakeSyncthingServer &server, int timeoutMs = 120000)
+{
+    QEventLoop loop;
+    QTimer poll;
+    QElapsedTimer clock;
+    clock.start();
+    int quietTicks = 0;
+    quint64 lastCount = server.requestCount();
+    QObject::connect(&poll, &QTimer::timeout, &loop, [&]() {
+        const bool idle = onApiThread(api, [api]() {
+            return api->getQueueSize() == 0 && api->getInFlightCount() == 0
+                    && api->getRetryStats().pending == 0;
+        });
+        quietTicks = (idle && server.requestCount() == lastCount) ? quietTicks + 1 : 0;
+        lastCount = server.requestCount();
+        if (quietTicks >= 2 || clock.elapsed() > timeoutMs)
+            loop.quit();
+    });
+    poll.start(20);
+    loop.exec();
+}
+
+// Drives the manager the way the UI does: renames, shares and status reads
+// while events are being polled.
+void runFlows(ApiHandler *api, FakeSyncthingServer &server, const BenchOptions &options,
+              const QString &home)
+{
+    const QString stateDir = home + QStringLiteral("/.local/state/syncthing");
+    QDir().mkpath(stateDir);
+    QFile configXml(stateDir + QStringLiteral("/config.xml"));
+    if (!configXml.open(QIODevice::WriteOnly | QIODevice::Text)) {
+        qWarning() << "Cannot write" << configXml.fileName();
+        return;
+    }
+    configXml.write(QStringLiteral("<configuration version=\"37\">\n"
+                                   "    <gui enabled=\"true\" tls=\"false\">\n"
+                                   "        <address>127.0.0.1:%1</address>\n"
+                                   "        <apikey>%2</apikey>\n"
+                                   "    </gui>\n"
+                                   "</configuration>\n")
+                    .arg(server.port()).arg(options.server.apiKey).toUtf8());
+    configXml.close();
+    qputenv("HOME", QFile::encodeName(home));
+
+    SyncthingManager *manager = SyncthingManager::getInstance();
+    waitForIdle(api, server);
+
+    server.resetCounters();
+    onApiThread(api, [api]() { api->resetEndpointMetrics(); return true; });
+    Sample sample;
+    Meter meter(api);
+    manager->startEventPolling(50);
+    for (int i = 0; i < options.flows; ++i) {
+        manager->renameLocalDevice(QStringLiteral("bench-%1").arg(i));
+        manager->shareFolderWithConnectedDevices(QStringLiteral("folder-%1").arg(i % qMax(1, options.server.folderCount)));
+        manager->querySystemStatus();
+        if (i % 10 == 0)
+            manager->getSystemLog();
+        QCoreApplication::processEvents();
+    }
+    manager->stopEventPolling();
+    waitForIdle(api, server);
+    meter.stop(sample);
+
+    // Wire latency from the handler's per-endpoint metrics.
+    const auto metrics = onApiThread(api, [api]() { return api->getEndpointMetrics(); });
+    for (auto it = metrics.begin(); it != metrics.end(); ++it)
+        sample.latencyUs.merge(it->wireUs);
+    printSample("flows", sample, server.requestCount());
+    const QHash<QString, quint64> byPath = server.requestsByPath();
+    for (auto it = byPath.begin(); it != byPath.end(); ++it)
+        std::printf("    %-36s %8llu\n", qPrintable(it.key()), (unsigned long long)it.value());
+}
+
+bool parseOptions(const QStringList &args, BenchOptions &options)
+{
+    for (const QString &arg : args.mid(1)) {
+        const QString name = arg.section(QLatin1Char('='), 0, 0);
+        const QString value = arg.section(QLatin1Char('='), 1);
+        if (name == QLatin1String("--requests")) options.requests = value.toInt();
+        else if (name == QLatin1String("--concurrency")) options.concurrency = qMax(1, value.toInt());
+        else if (name == QLatin1String("--threads")) options.threads = value.toInt();
+        else if (name == QLatin1String("--flows")) options.flows = value.toInt();
+        else if (name == QLatin1String("--threaded")) options.threaded = true;
+        else if (name == QLatin1String("--scenarios")) options.scenarios = value.split(QLatin1Char(','));
+        else if (name == QLatin1String("--latency")) options.server.latencyMs = value.toInt();
+        else if (name == QLatin1String("--jitter")) options.server.jitterMs = value.toInt();
+        else if (name == QLatin1String("--errors")) options.server.errorRate = value.toDouble();
+        else if (name == QLatin1String("--drops")) options.server.dropRate = value.toDouble();
+        else if (name == QLatin1String("--padding")) options.server.paddingBytes = value.toInt();
+        else if (name == QLatin1String("--devices")) options.server.deviceCount = value.toInt();
+        else if (name == QLatin1String("--folders")) options.server.folderCount = value.toInt();
+        else if (name == QLatin1String("--events")) options.server.eventsPerPoll = value.toInt();
+        else if (name == QLatin1String("--compress")) options.server.compress = true;
+        else if (name == QLatin1String("--rate")) options.rate = value.toInt();
+        else if (name == QLatin1String("--polls")) options.polls = value.toInt();
+        else {
+            std::fprintf(stderr, "Unknown option %s\n", qPrintable(arg));
+            return false;
+        }
+    }
+    return true;
+}
+
+} // namespace
+
+int main(int argc, char *argv[])
+{
+    QCoreApplication app(argc, argv);
+    BenchOptions options;
+    options.server.apiKey = QStringLiteral("apibench-key");
+    if (!parseOptions(app.arguments(), options))
+        return 2;
+    // Scratch HOME for the flows scenario; QDir::homePath() is read lazily.
+    QTemporaryDir home;
+    if (!home.isValid())
+        return 1;
+
+    FakeSyncthingServer server(options.server);
+    if (!server.listen())
+        return 1;
+
+    ApiHandler *api = ApiHandler::getInstance();
+    if (options.threaded)
+        api->startWorkerThread();
+    api->setApiKey(options.server.apiKey);
+    api->setBaseUrl(server.baseUrl());
+
+    std::printf("fake syncthing on %s: latency %d+%dms, errors %.2f, drops %.2f, padding %dB\n",
+                qPrintable(server.baseUrl().toString()), options.server.latencyMs,
+                options.server.jitterMs, options.server.errorRate, options.server.dropRate,
+                options.server.paddingBytes);
+    printHeader();
+    if (options.scenarios.contains(QLatin1String("get-qnam")))
+        runGet("get-qnam", api, new NetworkManagerTransport(), server, options);
+    Sample getHttp;
+    Sample getCopy;
+    if (options.scenarios.contains(QLatin1String("get-http")))
+        getHttp = runGet("get-http", api, HttpTransport::forTcp(QStringLiteral("127.0.0.1"), server.port()),
+                         server, options);
+    if (options.scenarios.contains(QLatin1String("get-copy")))
+        getCopy = runGet("get-copy", api, HttpTransport::forTcp(QStringLiteral("127.0.0.1"), server.port()),
+                         server, options, true);
+    if (getHttp.requests && getCopy.requests) {
+        const double after = double(getHttp.allocations) / getHttp.requests;
+        const double before = double(getCopy.allocations) / getCopy.requests;
+        std::printf("    allocs/req before %.1f, after %.1f: %.1f fewer (%.0f%%)\n", before, after,
+                    before - after, before > 0 ? 100 * (before - after) / before : 0.0);
+    }
+    if (options.scenarios.contains(QLatin1String("threads")))
+        runThreads(api, server, options);
+    if (options.scenarios.contains(QLatin1String("paced")))
+        runPaced(api, server, options);
+    if (options.scenarios.contains(QLatin1String("polls"))) {
+        runPolls("polls", api, server, options, true);
+        runPolls("polls-raw", api, server, options, false);
+    }
+    // Last: the manager's constructor installs caches and limits for good.
+    if (options.scenarios.contains(QLatin1String("flows")))
+        runFlows(api, server, options, home.path());
+    return 0;
+}
@@ -0,0 +1,20 @@
+# ApiHandler throughput benchmark against an in-process fake Syncthing.
+# Build with qmake and make; options are listed at the top of apibench.cpp.
+QT += core network
+QT -= gui
+
+CONFIG += console c++2a
+CONFIG -= app_bundle
+
+TARGET = apibench
+
+include(../SyncThingWrapper.pri)
+
+INCLUDEPATH += $$PWD/..
+
+SOURCES += \
+        $$PWD/fakesyncthing.cpp \
+        $$PWD/apibench.cpp
+
+HEADERS += \
+        $$PWD/fakesyncthing.h
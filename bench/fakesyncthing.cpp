@@ -0,0 +1,423 @@
+#include "fakesyncthing.h"
+#include "../urlbase.h"
+#include <QDebug>
+#include <QHostAddress>
+#include <QJsonDocument>
+#include <QPointer>
+#include <QRandomGenerator>
+#include <QTimer>
+#include <QUrlQuery>
+
+static const int MaxHeaderBytes = 64 * 1024;
+
+static QString fakeDeviceId(int index)
+{
+    const QString group = QString("%1").arg(index, 7, 10, QLatin1Char('0'));
+    QStringList groups;
+    for (int i = 0; i < 8; ++i)
+        groups << group;
+    return groups.join(QLatin1Char('-'));
+}
+
+FakeSyncthingServer::FakeSyncthingServer(const FakeSyncthingConfig &config, QObject *parent)
+    : QObject(parent),
+      m_server(this),
+      m_config(config),
+      m_lastEventId(0),
+      m_requestCount(0)
+{
+    connect(&m_server, &QTcpServer::newConnection, this, &FakeSyncthingServer::onNewConnection);
+    rebuildState();
+}
+
+bool FakeSyncthingServer::listen(quint16 port)
+{
+    if (!m_server.listen(QHostAddress(QHostAddress::LocalHost), port)) {
+        qWarning() << "Fake Syncthing cannot listen:" << m_server.errorString();
+        return false;
+    }
+    rebuildState();  // The config's GUI address carries the port.
+    return true;
+}
+
+quint16 FakeSyncthingServer::port() const
+{
+    return m_server.serverPort();
+}
+
+QUrl FakeSyncthingServer::baseUrl() const
+{
+    return QUrl(QString("http://127.0.0.1:%1").arg(port()));
+}
+
+QString FakeSyncthingServer::localDeviceId() const
+{
+    return fakeDeviceId(0);
+}
+
+void FakeSyncthingServer::setConfig(const FakeSyncthingConfig &config)
+{
+    m_config = config;
+    rebuildState();
+}
+
+const FakeSyncthingConfig &FakeSyncthingServer::config() const
+{
+    return m_config;
+}
+
+quint64 FakeSyncthingServer::requestCount() const
+{
+    return m_requestCount;
+}
+
+QHash<QString, quint64> FakeSyncthingServer::requestsByPath() const
+{
+    return m_requestsByPath;
+}
+
+void FakeSyncthingServer::resetCounters()
+{
+    m_requestCount = 0;
+    m_requestsByPath.clear();
+}
+
+// Device 0 is the local device; every other device is a connected peer
+// sharing every folder.
+void FakeSyncthingServer::rebuildState()
+{
+    QJsonArray devices;
+    for (int i = 0; i < qMax(1, m_config.deviceCount); ++i) {
+        QJsonObject device;
+        device["deviceID"] = fakeDeviceId(i);
+        device["name"] = QString("device-%1").arg(i);
+        device["addresses"] = QJsonArray{QString("tcp://10.0.%1.%2:22000").arg(i / 250).arg(i % 250 + 1)};
+        devices.append(device);
+    }
+    QJsonArray folders;
+    for (int i = 0; i < m_config.folderCount; ++i) {
+        QJsonArray shared;
+        for (const QJsonValue &device : devices)
+            shared.append(QJsonObject{{"deviceID", device.toObject().value("deviceID")}});
+        QJsonObject folder;
+        folder["id"] = QString("folder-%1").arg(i);
+        folder["label"] = QString("Folder %1").arg(i);
+        folder["path"] = QString("/tmp/fake-syncthing/folder-%1").arg(i);
+        folder["type"] = "sendreceive";
+        folder["devices"] = shared;
+        folders.append(folder);
+    }
+    m_systemConfig = QJsonObject();
+    m_systemConfig["version"] = 37;
+    m_systemConfig["devices"] = devices;
+    m_systemConfig["folders"] = folders;
+    m_systemConfig["gui"] = QJsonObject{{"address", baseUrl().authority()}};
+    m_systemConfig["options"] = QJsonObject{{"globalAnnounceEnabled", false}};
+}
+
+void FakeSyncthingServer::onNewConnection()
+{
+    while (m_server.hasPendingConnections()) {
+        QTcpSocket *socket = m_server.nextPendingConnection();
+        m_connections.insert(socket, Connection());
+        connect(socket, &QTcpSocket::readyRead, this, [this, socket]() {
+            onReadyRead(socket);
+        });
+        connect(socket, &QTcpSocket::disconnected, this, [this, socket]() {
+            m_connections.remove(socket);
+            socket->deleteLater();
+        });
+    }
+}
+
+void FakeSyncthingServer::onReadyRead(QTcpSocket *socket)
+{
+    auto it = m_connections.find(socket);
+    if (it == m_connections.end())
+        return;
+    it->buffer.append(socket->readAll());
+    Request request;
+    bool malformed = false;
+    while (takeRequest(*it, request, malformed)) {
+        ++m_requestCount;
+        ++m_requestsByPath[request.path];
+        auto response = std::make_shared<Response>();
+        QRandomGenerator *random = QRandomGenerator::global();
+        if (m_config.dropRate > 0 && random->generateDouble() < m_config.dropRate) {
+            response->close = true;
+        } else if (m_config.errorRate > 0 && random->generateDouble() < m_config.errorRate) {
+            response->data = httpResponse(500, QByteArrayLiteral("{\"error\":\"injected failure\"}"));
+        } else {
+            int status = 200;
+            const QByteArray body = route(request, status);
+            const bool deflate = m_config.compress && !body.isEmpty()
+                    && request.headers.value("accept-encoding").contains("deflate");
+            response->data = httpResponse(status, body, deflate);
+        }
+        it->pending.append(response);
+        schedule(socket, response);
+        it = m_connections.find(socket);
+        if (it == m_connections.end())
+            return;
+    }
+    if (malformed) {
+        it->pending.append(std::make_shared<Response>(Response{httpResponse(400, QByteArray()), true, true}));
+        flush(socket);
+    }
+}
+
+// Split one complete request off the connection buffer.
+bool FakeSyncthingServer::takeRequest(Connection &connection, Request &request, bool &malformed)
+{
+    const int headerEnd = connection.buffer.indexOf("\r\n\r\n");
+    if (headerEnd < 0) {
+        malformed = connection.buffer.size() > MaxHeaderBytes;
+        return false;
+    }
+    const QList<QByteArray> lines = connection.buffer.left(headerEnd).split('\n');
+    const QList<QByteArray> requestLine = lines.first().trimmed().split(' ');
+    if (requestLine.size() != 3) {
+        malformed = true;
+        return false;
+    }
+    request = Request();
+    for (int i = 1; i < lines.size(); ++i) {
+        const int colon = lines.at(i).indexOf(':');
+        if (colon > 0)
+            request.headers.insert(lines.at(i).left(colon).trimmed().toLower(),
+                                   lines.at(i).mid(colon + 1).trimmed());
+    }
+    if (request.headers.contains("transfer-encoding")) {
+        malformed = true;  // Clients under test always send Content-Length.
+        return false;
+    }
+    const int bodySize = request.headers.value("content-length", "0").toInt();
+    if (connection.buffer.size() < headerEnd + 4 + bodySize)
+        return false;
+    const QUrl target(QString::fromLatin1(requestLine.at(1)));
+    request.method = requestLine.at(0);
+    request.path = target.path();
+    request.query = target.query();
+    request.body = connection.buffer.mid(headerEnd + 4, bodySize);
+    connection.buffer.remove(0, headerEnd + 4 + bodySize);
+    return true;
+}
+
+void FakeSyncthingServer::schedule(QTcpSocket *socket, const std::shared_ptr<Response> &response)
+{
+    int delayMs = m_config.latencyMs;
+    if (m_config.jitterMs > 0)
+        delayMs += int(QRandomGenerator::global()->bounded(m_config.jitterMs + 1));
+    if (delayMs <= 0) {
+        response->ready = true;
+        flush(socket);
+        return;
+    }
+    const QPointer<QTcpSocket> guard(socket);
+    QTimer::singleShot(delayMs, this, [this, guard, response]() {
+        response->ready = true;
+        if (guard)
+            flush(guard.data());
+    });
+}
+
+// Write every response at the head of the line that is ready; a slow one
+// holds back those behind it, as HTTP/1.1 requires.
+void FakeSyncthingServer::flush(QTcpSocket *socket)
+{
+    auto it = m_connections.find(socket);
+    if (it == m_connections.end())
+        return;
+    while (!it->pending.isEmpty() && it->pending.first()->ready) {
+        const std::shared_ptr<Response> response = it->pending.takeFirst();
+        if (response->close) {
+            if (!response->data.isEmpty())
+                socket->write(response->data);
+            m_connections.erase(it);
+            socket->disconnectFromHost();
+            return;
+        }
+        socket->write(response->data);
+    }
+}
+
+QByteArray FakeSyncthingServer::httpResponse(int status, const QByteArray &body, bool deflate)
+{
+    const char *reason = status == 200 ? "OK"
+                       : status == 400 ? "Bad Request"
+                       : status == 403 ? "Forbidden"
+                       : status == 404 ? "Not Found"
+                       : status == 405 ? "Method Not Allowed"
+                       : "Internal Server Error";
+    // qCompress() output is a zlib stream behind a 4-byte length.
+    const QByteArray payload = deflate ? qCompress(body).mid(4) : body;
+    QByteArray data;
+    data.reserve(payload.size() + 160);
+    data += "HTTP/1.1 " + QByteArray::number(status) + ' ' + reason + "\r\n";
+    data += "Content-Type: application/json\r\n";
+    if (deflate)
+        data += "Content-Encoding: deflate\r\n";
+    data += "Content-Length: " + QByteArray::number(payload.size()) + "\r\n\r\n";
+    data += payload;
+    return data;
+}
+
+QByteArray FakeSyncthingServer::json(QJsonObject object) const
+{
+    if (m_config.paddingBytes > 0)
+        object["padding"] = QString(m_config.paddingBytes, QLatin1Char('x'));
+    return QJsonDocument(object).toJson(QJsonDocument::Compact);
+}
+
+QJsonArray FakeSyncthingServer::eventsSince(qint64 since)
+{
+    QJsonArray events;
+    const QJsonArray folders = m_systemConfig.value("folders").toArray();
+    for (int i = 0; i < m_config.eventsPerPoll; ++i) {
+        const qint64 id = qMax(since, m_lastEventId) + 1;
+        m_lastEventId = id;
+        const QString folder = folders.isEmpty() ? QString()
+                : folders.at(int(id % folders.size())).toObject().value("id").toString();
+        QJsonObject data{{"folder", folder},
+                         {"device", fakeDeviceId(1)},
+                         {"completion", (id % 4 == 0) ? 100 : int(id % 100)}};
+        events.append(QJsonObject{{"id", double(id)},
+                                  {"type", (id % 2) ? "FolderCompletion" : "StateChanged"},
+                                  {"time", "2024-01-01T00:00:00Z"},
+                                  {"data", data}});
+    }
+    return events;
+}
+
+// Replace or add entries of a config collection by their key field.
+static QJsonArray mergeByKey(QJsonArray current, const QJsonArray &updates, const QString &key)
+{
+    for (const QJsonValue &update : updates) {
+        const QString id = update.toObject().value(key).toString();
+        bool replaced = false;
+        for (int i = 0; i < current.size() && !replaced; ++i) {
+            if (current.at(i).toObject().value(key).toString() == id) {
+                QJsonObject merged = current.at(i).toObject();
+                const QJsonObject fields = update.toObject();
+                for (auto field = fields.begin(); field != fields.end(); ++field)
+                    merged[field.key()] = field.value();
+                current.replace(i, merged);
+                replaced = true;
+            }
+        }
+        if (!replaced)
+            current.append(update);
+    }
+    return current;
+}
+
+QByteArray FakeSyncthingServer::route(const Request &request, int &status)
+{
+    const QString &path = request.path;
+    const QByteArray &method = request.method;
+    if (path == QLatin1String(HEALTH))
+        return json(QJsonObject{{"status", "OK"}});
+    if (!m_config.apiKey.isEmpty() && request.headers.value("x-api-key") != m_config.apiKey.toUtf8()) {
+        status = 403;
+        return QByteArray();
+    }
+    const QJsonDocument posted = QJsonDocument::fromJson(request.body);
+
+    if (path == QLatin1String(PING))
+        return json(QJsonObject{{"ping", "pong"}});
+    if (path == QLatin1String(STATUS))
+        return json(QJsonObject{{"myID", localDeviceId()},
+                                {"uptime", 1234},
+                                {"discoveryErrors", QJsonObject()}});
+    if (path == QLatin1String(CONFIG)) {
+        if (method == "POST" || method == "PUT") {
+            if (!posted.isObject()) {
+                status = 400;
+                return QByteArray();
+            }
+            m_systemConfig = posted.object();
+            m_systemConfig.remove("padding");
+            return QByteArray();
+        }
+        return json(m_systemConfig);
+    }
+    for (const QString &collection : {QStringLiteral(CONFIGDEVICE), QStringLiteral(CONFIGFOLDER)}) {
+        const bool devices = collection == QLatin1String(CONFIGDEVICE);
+        const QString field = devices ? QStringLiteral("devices") : QStringLiteral("folders");
+        const QString key = devices ? QStringLiteral("deviceID") : QStringLiteral("id");
+        QJsonArray entries = m_systemConfig.value(field).toArray();
+        if (path == collection) {
+            if (method == "GET")
+                return QJsonDocument(entries).toJson(QJsonDocument::Compact);
+            const QJsonArray updates = posted.isArray() ? posted.array()
+                                                        : QJsonArray{posted.object()};
+            m_systemConfig[field] = mergeByKey(entries, updates, key);
+            return QByteArray();
+        }
+        if (path.startsWith(collection + QLatin1Char('/'))) {
+            const QString id = path.mid(collection.size() + 1);
+            for (int i = 0; i < entries.size(); ++i) {
+                if (entries.at(i).toObject().value(key).toString() != id)
+                    continue;
+                if (method == "DELETE") {
+                    entries.removeAt(i);
+                } else if (method == "GET") {
+                    return json(entries.at(i).toObject());
+                } else {
+                    QJsonObject update = posted.object();
+                    update[key] = id;
+                    entries = mergeByKey(entries, QJsonArray{update}, key);
+                }
+                m_systemConfig[field] = entries;
+                return QByteArray();
+            }
+            status = 404;
+            return QByteArray();
+        }
+    }
+    if (path == QLatin1String(CONNECTEDDEVICE)) {
+        QJsonObject connections;
+        const QJsonArray devices = m_systemConfig.value("devices").toArray();
+        for (const QJsonValue &device : devices) {
+            const QString id = device.toObject().value("deviceID").toString();
+            if (id != localDeviceId())
+                connections[id] = QJsonObject{{"connected", true},
+                                              {"address", device.toObject().value("addresses").toArray().at(0)}};
+        }
+        return json(QJsonObject{{"connections", connections}, {"total", QJsonObject()}});
+    }
+    if (path == QLatin1String(DISCOVERY)) {
+        QJsonObject discovered;
+        const QJsonArray devices = m_systemConfig.value("devices").toArray();
+        for (const QJsonValue &device : devices) {
+            const QJsonObject entry = device.toObject();
+            if (entry.value("deviceID").toString() != localDeviceId())
+                discovered[entry.value("deviceID").toString()] = QJsonObject{{"addresses", entry.value("addresses")}};
+        }
+        return json(discovered);
+    }
+    if (path == QLatin1String(PENDINGDEVICE) || path == QLatin1String(PENDINGFOLDSERS))
+        return json(QJsonObject());
+    if (path == QLatin1String(SYNCTHINGLOG)) {
+        QJsonArray messages;
+        for (int i = 0; i < m_config.logMessages; ++i)
+            messages.append(QJsonObject{{"when", "2024-01-01T00:00:00Z"},
+                                        {"message", QString("Fake log line %1").arg(i)},
+                                        {"level", 2}});
+        return json(QJsonObject{{"messages", messages}});
+    }
+    // Never long-polls: a batch of events is always ready.
+    if (path == QLatin1String(EVENTS)) {
+        const qint64 since = QUrlQuery(request.query).queryItemValue("since").toLongLong();
+        return QJsonDocument(eventsSince(since)).toJson(QJsonDocument::Compact);
+    }
+    if (path == QLatin1String(PAUSEDEVICE) || path == QLatin1String(RESUMEDEVICE)
+            || path == QLatin1String(RESCAN) || path == QLatin1String(DBOVERRIDE)
+            || path == QLatin1String(DISCONNECTDEVICE)) {
+        if (method != "POST")
+            status = 405;
+        return QByteArray();
+    }
+    status = 404;
+    return QByteArray();
+}
@@ -0,0 +1,90 @@
+#ifndef FAKESYNCTHING_H
+#define FAKESYNCTHING_H
+
+#include <QObject>
+#include <QTcpServer>
+#include <QTcpSocket>
+#include <QJsonObject>
+#include <QJsonArray>
+#include <QHash>
+#include <QList>
+#include <QUrl>
+#include <memory>
+
+// Knobs for the emulated daemon.
+struct FakeSyncthingConfig {
+    int latencyMs = 0;          // Fixed delay before every response.
+    int jitterMs = 0;           // Extra uniformly random delay on top.
+    double errorRate = 0.0;     // Share of requests answered with 500.
+    double dropRate = 0.0;      // Share of requests whose connection is closed unanswered.
+    int deviceCount = 4;
+    int folderCount = 4;
+    int eventsPerPoll = 10;     // Events returned by each /rest/events call.
+    int logMessages = 100;      // Entries in /rest/system/log.
+    int paddingBytes = 0;       // Filler added to every JSON object body.
+    bool compress = false;      // Deflate bodies for clients that accept it.
+    QString apiKey;             // Required X-API-Key when not empty.
+};
+
+// In-process stand-in for the Syncthing REST API, for benchmarks. Serves
+// the endpoints in urlbase.h and /rest/events over HTTP/1.1 on 127.0.0.1,
+// with keep-alive and pipelining; responses on one connection always go
+// out in request order, however their delays fall. Config writes are
+// applied, so multi-step flows see their own changes.
+class FakeSyncthingServer : public QObject
+{
+    Q_OBJECT
+public:
+    explicit FakeSyncthingServer(const FakeSyncthingConfig &config, QObject *parent = nullptr);
+
+    bool listen(quint16 port = 0);
+    quint16 port() const;
+    QUrl baseUrl() const;
+    QString localDeviceId() const;
+
+    void setConfig(const FakeSyncthingConfig &config); // Also rebuilds the daemon's state.
+    const FakeSyncthingConfig &config() const;
+
+    quint64 requestCount() const;
+    QHash<QString, quint64> requestsByPath() const;
+    void resetCounters();
+
+private:
+    struct Response {
+        QByteArray data;
+        bool ready = false;
+        bool close = false;     // Drop the connection instead of answering.
+    };
+    struct Connection {
+        QByteArray buffer;
+        QList<std::shared_ptr<Response>> pending;   // In request order.
+    };
+    struct Request {
+        QByteArray method;
+        QString path;
+        QString query;
+        QByteArray body;
+        QHash<QByteArray, QByteArray> headers;  // Lower-cased names.
+    };
+
+    void onNewConnection();
+    void onReadyRead(QTcpSocket *socket);
+    bool takeRequest(Connection &connection, Request &request, bool &malformed);
+    void schedule(QTcpSocket *socket, const std::shared_ptr<Response> &response);
+    void flush(QTcpSocket *socket);
+    QByteArray route(const Request &request, int &status);
+    static QByteArray httpResponse(int status, const QByteArray &body, bool deflate = false);
+    QByteArray json(QJsonObject object) const;
+    void rebuildState();
+    QJsonArray eventsSince(qint64 since);
+
+    QTcpServer m_server;
+    FakeSyncthingConfig m_config;
+    QHash<QTcpSocket*, Connection> m_connections;
+    QJsonObject m_systemConfig;     // What /rest/system/config returns.
+    qint64 m_lastEventId;
+    quint64 m_requestCount;
+    QHash<QString, quint64> m_requestsByPath;
+};
+
+#endif // FAKESYNCTHING_H
@@ -23,6 +23,10 @@ public:
     /// Returns the extracted API key.
     QString apiKey() const;
 
+    /// Returns the Unix socket path the GUI listens on, or an empty string
+    /// when it listens on TCP.
+    QString guiSocketPath() const;
+
 
     void setLastEvent(int port);
     int getLastEvent() const;
@@ -31,12 +35,15 @@ public:
     void setsyncName(QString name);
     bool getWrapperIsServer() const;
     void setWrapperIsServer(bool isServer);
+    bool getApiThreaded() const;
+    bool getRequestJournal() const;
 private:
     bool loadBinaryConfig();
     QJsonObject xml2json(QXmlStreamReader &xml);
 
     QString m_baseUrl;
     QString m_apiKey;
+    QString m_guiSocketPath;
     QJsonObject config;
     QString configPath;
 
@@ -82,7 +82,16 @@ bool ConfigHandler::loadBinaryConfig()
     qDebug() << "GUI Address:" << address;
 
     m_apiKey= apikey;
-    m_baseUrl = QString("http://"+address);
+    // Syncthing treats an absolute path as a Unix socket listener. Requests
+    // then go over the socket and the URL only supplies the Host header.
+    if (address.startsWith("unix://"))
+        address = address.mid(7);
+    if (address.startsWith('/')) {
+        m_guiSocketPath = address;
+        m_baseUrl = QString("http://localhost");
+    } else {
+        m_baseUrl = QString("http://"+address);
+    }
     return true;
 }
 
@@ -96,6 +105,11 @@ QString ConfigHandler::apiKey() const
     return m_apiKey;
 }
 
+QString ConfigHandler::guiSocketPath() const
+{
+    return m_guiSocketPath;
+}
+
 QJsonObject ConfigHandler::xml2json(QXmlStreamReader &xml)
 {
     QJsonObject jsonObj;
@@ -213,3 +227,15 @@ void ConfigHandler::setWrapperIsServer(bool isServer) {
     settings.setValue("Syncthing/IsServer", isServer);
     qDebug() << "Event updated to:" << isServer;
 }
+
+// Whether ApiHandler runs on its own thread instead of the UI thread
+bool ConfigHandler::getApiThreaded() const {
+    QSettings settings(SERVICECONFIG, QSettings::IniFormat);
+    return settings.value("Syncthing/ApiThread", "false").toBool(); // Default to the UI thread
+}
+
+// Whether config mutations are journaled and replayed after a restart
+bool ConfigHandler::getRequestJournal() const {
+    QSettings settings(SERVICECONFIG, QSettings::IniFormat);
+    return settings.value("Syncthing/Journal", "false").toBool(); // Default to no journal
+}
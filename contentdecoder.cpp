@@ -0,0 +1,152 @@
+#include "contentdecoder.h"
+#include <zlib.h>
+
+static const int ChunkBytes = 16 * 1024;
+
+ContentDecoder::ContentDecoder()
+    : m_coding(Unset),
+      m_stream(nullptr),
+      m_ended(false),
+      m_triedRaw(false),
+      m_failed(false),
+      m_bytesIn(0),
+      m_bytesOut(0)
+{
+}
+
+ContentDecoder::~ContentDecoder()
+{
+    if (m_stream) {
+        inflateEnd(m_stream);
+        delete m_stream;
+    }
+}
+
+bool ContentDecoder::begin(const QByteArray &contentEncoding)
+{
+    const QByteArray coding = contentEncoding.trimmed().toLower();
+    if (coding.isEmpty() || coding == "identity") {
+        m_coding = Identity;
+        return true;
+    }
+    if (coding == "gzip" || coding == "x-gzip")
+        m_coding = Gzip;
+    else if (coding == "deflate")
+        m_coding = Deflate;
+    else
+        return fail(QStringLiteral("Unsupported Content-Encoding: %1").arg(QString::fromLatin1(coding)));
+
+    m_stream = new z_stream();
+    // 15 + 32: zlib detects a gzip or zlib header by itself.
+    if (inflateInit2(m_stream, 15 + 32) != Z_OK) {
+        delete m_stream;
+        m_stream = nullptr;
+        return fail(QStringLiteral("Cannot initialise zlib"));
+    }
+    return true;
+}
+
+bool ContentDecoder::isStarted() const
+{
+    return m_coding != Unset;
+}
+
+bool ContentDecoder::isCompressed() const
+{
+    return m_coding == Gzip || m_coding == Deflate;
+}
+
+// Some servers send "deflate" without the zlib wrapper.
+bool ContentDecoder::restartRaw()
+{
+    inflateEnd(m_stream);
+    *m_stream = z_stream();
+    return inflateInit2(m_stream, -15) == Z_OK;
+}
+
+bool ContentDecoder::decode(const QByteArray &input, QByteArray &output)
+{
+    if (m_failed)
+        return false;
+    m_bytesIn += input.size();
+    if (!isCompressed()) {
+        output += input;
+        m_bytesOut += input.size();
+        return true;
+    }
+    if (m_ended || input.isEmpty())
+        return true;  // Anything after the end of the stream is ignored.
+
+    // Until deflate has produced output, keep what it was fed: a raw stream
+    // is only recognised a few bytes in, and must then be replayed.
+    const bool mayFallBack = m_coding == Deflate && !m_triedRaw && m_bytesOut == 0;
+    if (mayFallBack)
+        m_head += input;
+    const QByteArray &feed = mayFallBack ? m_head : input;
+    const int alreadyFed = mayFallBack ? m_head.size() - input.size() : 0;
+    m_stream->next_in = reinterpret_cast<Bytef*>(const_cast<char*>(feed.constData())) + alreadyFed;
+    m_stream->avail_in = uInt(input.size());
+    for (;;) {
+        const int start = output.size();
+        output.resize(start + ChunkBytes);
+        m_stream->next_out = reinterpret_cast<Bytef*>(output.data() + start);
+        m_stream->avail_out = ChunkBytes;
+        const int rc = inflate(m_stream, Z_NO_FLUSH);
+        const int produced = ChunkBytes - int(m_stream->avail_out);
+        output.resize(start + produced);
+        if (rc == Z_DATA_ERROR && mayFallBack && !m_triedRaw) {
+            m_triedRaw = true;
+            if (!restartRaw())
+                return fail(QStringLiteral("Cannot initialise zlib"));
+            m_stream->next_in = reinterpret_cast<Bytef*>(const_cast<char*>(feed.constData()));
+            m_stream->avail_in = uInt(feed.size());
+            continue;
+        }
+        m_bytesOut += produced;
+        if (rc == Z_STREAM_END) {
+            m_ended = true;
+            break;
+        }
+        if (rc != Z_OK && rc != Z_BUF_ERROR)
+            return fail(QStringLiteral("Corrupt %1 body: %2")
+                        .arg(m_coding == Gzip ? QStringLiteral("gzip") : QStringLiteral("deflate"),
+                             QString::fromLatin1(m_stream->msg ? m_stream->msg : "inflate failed")));
+        // Done once all input is consumed and zlib had room to spare.
+        if (m_stream->avail_in == 0 && m_stream->avail_out > 0)
+            break;
+    }
+    if (m_bytesOut > 0 || m_triedRaw)
+        m_head.clear();
+    return true;
+}
+
+bool ContentDecoder::finish()
+{
+    if (m_failed)
+        return false;
+    if (isCompressed() && !m_ended)
+        return fail(QStringLiteral("Compressed body ended early"));
+    return true;
+}
+
+QString ContentDecoder::errorString() const
+{
+    return m_error;
+}
+
+qint64 ContentDecoder::bytesIn() const
+{
+    return m_bytesIn;
+}
+
+qint64 ContentDecoder::bytesOut() const
+{
+    return m_bytesOut;
+}
+
+bool ContentDecoder::fail(const QString &message)
+{
+    m_failed = true;
+    m_error = message;
+    return false;
+}
@@ -0,0 +1,54 @@
+#ifndef CONTENTDECODER_H
+#define CONTENTDECODER_H
+
+#include <QByteArray>
+#include <QString>
+
+struct z_stream_s;
+
+// Incremental decoder for an HTTP Content-Encoding. Compressed bytes are fed
+// as they arrive and whatever they inflate to is appended to the output, so
+// a streamed reply can be parsed without first holding the whole body.
+// Handles gzip and deflate (zlib-wrapped or raw); identity passes through.
+class ContentDecoder
+{
+public:
+    ContentDecoder();
+    ~ContentDecoder();
+    ContentDecoder(const ContentDecoder&) = delete;
+    ContentDecoder& operator=(const ContentDecoder&) = delete;
+
+    // Pick the coding from the reply's Content-Encoding header. Returns false
+    // for a coding we never offered.
+    bool begin(const QByteArray &contentEncoding);
+    bool isStarted() const;
+    bool isCompressed() const;
+
+    // Appends the decoded form of `input` to `output`. Returns false once the
+    // data is corrupt.
+    bool decode(const QByteArray &input, QByteArray &output);
+    // Call after the last chunk. Returns false if the stream was cut short.
+    bool finish();
+
+    QString errorString() const;
+    qint64 bytesIn() const;     // As received.
+    qint64 bytesOut() const;    // After decoding.
+
+private:
+    enum Coding { Unset, Identity, Gzip, Deflate };
+
+    bool fail(const QString &message);
+    bool restartRaw();
+
+    Coding m_coding;
+    z_stream_s *m_stream;
+    bool m_ended;           // zlib has seen the end of the compressed stream.
+    bool m_triedRaw;        // Already fell back to raw deflate.
+    QByteArray m_head;      // Deflate input fed before any output appeared.
+    bool m_failed;
+    qint64 m_bytesIn;
+    qint64 m_bytesOut;
+    QString m_error;
+};
+
+#endif // CONTENTDECODER_H
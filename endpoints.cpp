@@ -0,0 +1,16 @@
+#include "endpoints.h"
+
+void EndpointUrls::rebase(const QUrl &baseUrl)
+{
+    for (int i = 0; i < int(Endpoint::Count); ++i) {
+        m_urls[i] = baseUrl;
+        m_urls[i].setPath(QLatin1String(EndpointPaths[i]));
+    }
+}
+
+QUrl EndpointUrls::url(Endpoint endpoint, const QString &item) const
+{
+    QUrl itemUrl = m_urls[int(endpoint)];
+    itemUrl.setPath(QLatin1String(endpointPath(endpoint)) + QLatin1Char('/') + item);
+    return itemUrl;
+}
@@ -0,0 +1,56 @@
+#ifndef ENDPOINTS_H
+#define ENDPOINTS_H
+
+#include <QUrl>
+#include <QString>
+#include "urlbase.h"
+
+// Syncthing REST endpoints, one per distinct urlbase.h path.
+enum class Endpoint {
+    PauseDevice,        // PAUSEDEVICE
+    ResumeDevice,       // RESUMEDEVICE
+    Health,             // HEALTH
+    Rescan,             // RESCAN
+    SystemStatus,       // STATUS, MYSTATUS
+    ConfigFolders,      // CONFIGFOLDER
+    ConfigDevices,      // CONFIGDEVICE, REQUESTCONNECTION
+    PendingDevices,     // PENDINGDEVICE
+    PendingFolders,     // PENDINGFOLDSERS
+    Connections,        // CONNECTEDDEVICE
+    DbOverride,         // DBOVERRIDE
+    ClusterDisconnect,  // DISCONNECTDEVICE
+    Ping,               // PING
+    SystemConfig,       // CONFIG
+    Discovery,          // DISCOVERY
+    SystemLog,          // SYNCTHINGLOG
+    Events,             // EVENTS
+    Count
+};
+
+constexpr const char *EndpointPaths[] = {
+    PAUSEDEVICE, RESUMEDEVICE, HEALTH, RESCAN, STATUS, CONFIGFOLDER, CONFIGDEVICE,
+    PENDINGDEVICE, PENDINGFOLDSERS, CONNECTEDDEVICE, DBOVERRIDE, DISCONNECTDEVICE,
+    PING, CONFIG, DISCOVERY, SYNCTHINGLOG, EVENTS
+};
+static_assert(sizeof(EndpointPaths) / sizeof(EndpointPaths[0]) == int(Endpoint::Count),
+              "EndpointPaths must list every Endpoint");
+
+constexpr const char *endpointPath(Endpoint endpoint)
+{
+    return EndpointPaths[int(endpoint)];
+}
+
+// Absolute URLs of every endpoint, resolved once per base URL. Requests take
+// a reference-counted copy instead of rebuilding the URL each time.
+class EndpointUrls
+{
+public:
+    void rebase(const QUrl &baseUrl);
+    const QUrl &url(Endpoint endpoint) const { return m_urls[int(endpoint)]; }
+    QUrl url(Endpoint endpoint, const QString &item) const;
+
+private:
+    QUrl m_urls[int(Endpoint::Count)];
+};
+
+#endif // ENDPOINTS_H
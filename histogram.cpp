@@ -0,0 +1,50 @@
+#include "histogram.h"
+#include <cmath>
+#include <cstring>
+
+Histogram::Histogram()
+{
+    reset();
+}
+
+void Histogram::reset()
+{
+    memset(m_counts, 0, sizeof(m_counts));
+    m_count = 0;
+    m_sum = 0;
+    m_min = ~Q_UINT64_C(0);
+    m_max = 0;
+}
+
+void Histogram::merge(const Histogram &other)
+{
+    for (int i = 0; i < BucketCount; ++i)
+        m_counts[i] += other.m_counts[i];
+    m_count += other.m_count;
+    m_sum += other.m_sum;
+    m_min = qMin(m_min, other.m_min);
+    m_max = qMax(m_max, other.m_max);
+}
+
+quint64 Histogram::percentile(double percent) const
+{
+    if (m_count == 0)
+        return 0;
+    const quint64 rank = qMax<quint64>(1, quint64(std::ceil(qBound(0.0, percent, 100.0) / 100.0 * m_count)));
+    quint64 seen = 0;
+    for (int i = 0; i < BucketCount; ++i) {
+        seen += m_counts[i];
+        if (seen >= rank)
+            return qMin(bucketUpperBound(i), m_max);
+    }
+    return m_max;
+}
+
+quint64 Histogram::bucketUpperBound(int index)
+{
+    if (index < SubBuckets)
+        return quint64(index);
+    const int shift = index / SubBuckets - 1;
+    const quint64 lower = quint64(SubBuckets + index % SubBuckets) << shift;
+    return lower + (Q_UINT64_C(1) << shift) - 1;
+}
@@ -0,0 +1,59 @@
+#ifndef HISTOGRAM_H
+#define HISTOGRAM_H
+
+#include <QtGlobal>
+#include <QtAlgorithms>
+
+// Fixed-size log-linear histogram in the style of HdrHistogram. Each power of
+// two is split into 8 linear sub-buckets, so a bucket's bounds are within
+// 12.5% of any value in it. Recording is a bit scan and an increment, with no
+// allocation. Values above MaxValue are counted in the last bucket.
+class Histogram
+{
+public:
+    static const int SubBucketBits = 3;
+    static const int SubBuckets = 1 << SubBucketBits;
+    static const int MaxValueBits = 40;
+    static const quint64 MaxValue = (Q_UINT64_C(1) << MaxValueBits) - 1;
+    static const int BucketCount = (MaxValueBits - SubBucketBits + 1) * SubBuckets;
+
+    Histogram();
+
+    void record(quint64 value)
+    {
+        const int index = bucketFor(qMin(value, quint64(MaxValue)));
+        ++m_counts[index];
+        ++m_count;
+        m_sum += value;
+        m_min = qMin(m_min, value);
+        m_max = qMax(m_max, value);
+    }
+
+    quint64 count() const { return m_count; }
+    quint64 min() const { return m_count ? m_min : 0; }
+    quint64 max() const { return m_max; }
+    double mean() const { return m_count ? double(m_sum) / m_count : 0; }
+    // Upper bound of the bucket holding the given percentile (0-100).
+    quint64 percentile(double percent) const;
+
+    void merge(const Histogram &other);
+    void reset();
+
+private:
+    static int bucketFor(quint64 value)
+    {
+        if (value < SubBuckets)
+            return int(value);
+        const int shift = 63 - int(qCountLeadingZeroBits(value)) - SubBucketBits;
+        return (shift + 1) * SubBuckets + int(value >> shift) - SubBuckets;
+    }
+    static quint64 bucketUpperBound(int index);
+
+    quint32 m_counts[BucketCount];
+    quint64 m_count;
+    quint64 m_sum;
+    quint64 m_min;
+    quint64 m_max;
+};
+
+#endif // HISTOGRAM_H
@@ -0,0 +1,520 @@
+#include "httptransport.h"
+#include <QDebug>
+#include <cstring>
+
+static const int MaxHeaderLineLength = 16 * 1024;
+
+HttpReply::HttpReply(const QNetworkRequest &request, const QByteArray &verb, HttpTransport *transport)
+    : QNetworkReply(transport),
+      m_transport(transport),
+      m_status(0),
+      m_aborted(false)
+{
+    setRequest(request);
+    setUrl(request.url());
+    setOperation(QNetworkAccessManager::CustomOperation);
+    setAttribute(QNetworkRequest::CustomVerbAttribute, verb);
+    open(QIODevice::ReadOnly | QIODevice::Unbuffered);
+}
+
+void HttpReply::abort()
+{
+    if (isFinished())
+        return;
+    m_aborted = true;
+    m_body.clear();
+    setError(QNetworkReply::OperationCanceledError, tr("Operation canceled"));
+    setFinished(true);
+    if (m_transport)
+        m_transport->onReplyAborted(this);
+    emit finished();
+}
+
+qint64 HttpReply::bytesAvailable() const
+{
+    return m_body.size() + QNetworkReply::bytesAvailable();
+}
+
+qint64 HttpReply::readData(char *data, qint64 maxSize)
+{
+    if (m_body.isEmpty())
+        return isFinished() ? -1 : 0;
+    const qint64 size = qMin<qint64>(maxSize, m_body.size());
+    memcpy(data, m_body.constData(), size_t(size));
+    m_body.remove(0, int(size));
+    return size;
+}
+
+void HttpReply::setResponseHead(int status, const QByteArray &reason,
+                                const QList<QPair<QByteArray, QByteArray>> &headers)
+{
+    m_status = status;
+    setAttribute(QNetworkRequest::HttpStatusCodeAttribute, status);
+    setAttribute(QNetworkRequest::HttpReasonPhraseAttribute, reason);
+    for (const auto &header : headers)
+        setRawHeader(header.first, header.second);
+    emit metaDataChanged();
+}
+
+void HttpReply::appendBody(const QByteArray &data)
+{
+    m_body.append(data);
+    emit readyRead();
+}
+
+// HTTP errors are reported the way QNetworkAccessManager reports them, so
+// callers see the same error codes whichever transport is in use.
+void HttpReply::complete()
+{
+    if (isFinished())
+        return;
+    if (m_status >= 400) {
+        setError(errorForStatus(m_status),
+                 QString("Error transferring %1 - server replied: %2")
+                 .arg(url().toString(),
+                      QString::fromLatin1(attribute(QNetworkRequest::HttpReasonPhraseAttribute).toByteArray())));
+    }
+    setFinished(true);
+    emit finished();
+}
+
+void HttpReply::fail(QNetworkReply::NetworkError error, const QString &message)
+{
+    if (isFinished())
+        return;
+    setError(error, message);
+    setFinished(true);
+    emit finished();
+}
+
+QNetworkReply::NetworkError HttpReply::errorForStatus(int status)
+{
+    switch (status) {
+    case 401: return QNetworkReply::AuthenticationRequiredError;
+    case 403: return QNetworkReply::ContentAccessDenied;
+    case 404: return QNetworkReply::ContentNotFoundError;
+    case 405: return QNetworkReply::ContentOperationNotPermittedError;
+    case 409: return QNetworkReply::ContentConflictError;
+    case 410: return QNetworkReply::ContentGoneError;
+    case 500: return QNetworkReply::InternalServerError;
+    case 501: return QNetworkReply::OperationNotImplementedError;
+    case 503: return QNetworkReply::ServiceUnavailableError;
+    default:
+        return status >= 500 ? QNetworkReply::UnknownServerError : QNetworkReply::UnknownContentError;
+    }
+}
+
+HttpTransport::HttpTransport(QObject *parent)
+    : ApiTransport(parent),
+      m_localSocket(nullptr),
+      m_tcpSocket(nullptr),
+      m_port(0),
+      m_maxPipelineDepth(8),
+      m_writeScheduled(false),
+      m_state(StatusLine),
+      m_status(0),
+      m_remaining(0),
+      m_chunked(false),
+      m_hasLength(false),
+      m_closeAfter(false)
+{
+}
+
+HttpTransport *HttpTransport::forLocalSocket(const QString &socketPath, QObject *parent)
+{
+    HttpTransport *transport = new HttpTransport(parent);
+    transport->m_socketPath = socketPath;
+    QLocalSocket *socket = new QLocalSocket(transport);
+    transport->m_localSocket = socket;
+    connect(socket, &QLocalSocket::connected, transport, &HttpTransport::writePending);
+    connect(socket, &QLocalSocket::readyRead, transport, &HttpTransport::onReadyRead);
+    connect(socket, &QLocalSocket::disconnected, transport, &HttpTransport::onDisconnected);
+    connect(socket, &QLocalSocket::errorOccurred, transport,
+            [transport, socket](QLocalSocket::LocalSocketError error) {
+        QNetworkReply::NetworkError mapped = QNetworkReply::UnknownNetworkError;
+        if (error == QLocalSocket::ServerNotFoundError || error == QLocalSocket::ConnectionRefusedError)
+            mapped = QNetworkReply::ConnectionRefusedError;
+        else if (error == QLocalSocket::PeerClosedError)
+            mapped = QNetworkReply::RemoteHostClosedError;
+        transport->onSocketError(mapped, socket->errorString());
+    });
+    return transport;
+}
+
+HttpTransport *HttpTransport::forTcp(const QString &host, quint16 port, QObject *parent)
+{
+    HttpTransport *transport = new HttpTransport(parent);
+    transport->m_host = host;
+    transport->m_port = port;
+    QTcpSocket *socket = new QTcpSocket(transport);
+    transport->m_tcpSocket = socket;
+    connect(socket, &QTcpSocket::connected, transport, [transport, socket]() {
+        // Pipelined requests are small; do not let Nagle hold them back.
+        socket->setSocketOption(QAbstractSocket::LowDelayOption, 1);
+        transport->writePending();
+    });
+    connect(socket, &QTcpSocket::readyRead, transport, &HttpTransport::onReadyRead);
+    connect(socket, &QTcpSocket::disconnected, transport, &HttpTransport::onDisconnected);
+    connect(socket, &QTcpSocket::errorOccurred, transport,
+            [transport, socket](QAbstractSocket::SocketError error) {
+        QNetworkReply::NetworkError mapped = QNetworkReply::UnknownNetworkError;
+        if (error == QAbstractSocket::ConnectionRefusedError)
+            mapped = QNetworkReply::ConnectionRefusedError;
+        else if (error == QAbstractSocket::RemoteHostClosedError)
+            mapped = QNetworkReply::RemoteHostClosedError;
+        else if (error == QAbstractSocket::HostNotFoundError)
+            mapped = QNetworkReply::HostNotFoundError;
+        else if (error == QAbstractSocket::SocketTimeoutError)
+            mapped = QNetworkReply::TimeoutError;
+        transport->onSocketError(mapped, socket->errorString());
+    });
+    return transport;
+}
+
+void HttpTransport::setMaxPipelineDepth(int depth)
+{
+    m_maxPipelineDepth = qMax(1, depth);
+}
+
+QIODevice *HttpTransport::socket() const
+{
+    if (m_localSocket)
+        return m_localSocket;
+    return m_tcpSocket;
+}
+
+bool HttpTransport::isConnected() const
+{
+    if (m_localSocket)
+        return m_localSocket->state() == QLocalSocket::ConnectedState;
+    return m_tcpSocket->state() == QAbstractSocket::ConnectedState;
+}
+
+void HttpTransport::ensureConnected()
+{
+    if (m_localSocket) {
+        if (m_localSocket->state() == QLocalSocket::UnconnectedState)
+            m_localSocket->connectToServer(m_socketPath);
+    } else if (m_tcpSocket->state() == QAbstractSocket::UnconnectedState) {
+        m_tcpSocket->connectToHost(m_host, m_port);
+    }
+}
+
+QNetworkReply *HttpTransport::send(const QNetworkRequest &request, const QByteArray &verb,
+                                   const QByteArray &body)
+{
+    HttpReply *reply = new HttpReply(request, verb, this);
+    const QUrl url = request.url();
+
+    PendingRequest pending;
+    pending.reply = reply;
+    pending.pipelinable = (verb == "GET" || verb == "HEAD");
+    pending.expectsBody = (verb != "HEAD");
+
+    QByteArray &wire = pending.wire;
+    wire.reserve(256 + body.size());
+    QByteArray target = url.toEncoded(QUrl::RemoveScheme | QUrl::RemoveAuthority | QUrl::RemoveFragment);
+    if (target.isEmpty())
+        target = "/";
+    wire += verb + ' ' + target + " HTTP/1.1\r\nHost: " + url.host().toLatin1();
+    if (url.port() != -1)
+        wire += ':' + QByteArray::number(url.port());
+    wire += "\r\n";
+    for (const QByteArray &name : request.rawHeaderList())
+        wire += name + ": " + request.rawHeader(name) + "\r\n";
+    const QVariant contentType = request.header(QNetworkRequest::ContentTypeHeader);
+    if (contentType.isValid())
+        wire += "Content-Type: " + contentType.toByteArray() + "\r\n";
+    if (!body.isEmpty() || !pending.pipelinable)
+        wire += "Content-Length: " + QByteArray::number(body.size()) + "\r\n";
+    wire += "\r\n";
+    wire += body;
+
+    m_unsent.enqueue(pending);
+    // Write from the event loop so a failing connect never finishes the reply
+    // before the caller has connected to it, and a burst goes out together.
+    if (!m_writeScheduled) {
+        m_writeScheduled = true;
+        QMetaObject::invokeMethod(this, [this]() {
+            m_writeScheduled = false;
+            writePending();
+        }, Qt::QueuedConnection);
+    }
+    return reply;
+}
+
+// GETs share the pipeline up to its depth; anything else goes out alone.
+void HttpTransport::writePending()
+{
+    if (!isConnected()) {
+        if (!m_unsent.isEmpty())
+            ensureConnected();
+        return;
+    }
+    while (!m_unsent.isEmpty() && m_awaiting.size() < m_maxPipelineDepth) {
+        const PendingRequest &next = m_unsent.head();
+        if (!next.reply || next.reply->isFinished()) {
+            m_unsent.dequeue();
+            continue;
+        }
+        if (!m_awaiting.isEmpty() && !(next.pipelinable && m_awaiting.last().pipelinable))
+            break;
+        PendingRequest pending = m_unsent.dequeue();
+        socket()->write(pending.wire);
+        m_awaiting.enqueue(pending);
+    }
+}
+
+void HttpTransport::onReadyRead()
+{
+    m_buffer.append(socket()->readAll());
+    while (parseStep()) {}
+}
+
+// Consume one parser step from the buffer. Returns false when more input is
+// needed or the connection was torn down.
+bool HttpTransport::parseStep()
+{
+    if (m_state == Body || m_state == ChunkData || m_state == BodyUntilClose) {
+        const qint64 size = (m_state == BodyUntilClose) ? m_buffer.size()
+                                                        : qMin<qint64>(m_remaining, m_buffer.size());
+        if (size == 0)
+            return false;
+        deliverBody(size);
+        if (m_state == BodyUntilClose)
+            return false;
+        m_remaining -= size;
+        if (m_remaining > 0)
+            return false;
+        if (m_state == Body)
+            completeResponse();
+        else
+            m_state = ChunkEnd;
+        return true;
+    }
+
+    const int eol = m_buffer.indexOf("\r\n");
+    if (eol < 0) {
+        if (m_buffer.size() > MaxHeaderLineLength)
+            protocolError(QStringLiteral("Response header line too long"));
+        return false;
+    }
+    const QByteArray line = m_buffer.left(eol);
+    m_buffer.remove(0, eol + 2);
+
+    switch (m_state) {
+    case StatusLine: {
+        if (m_awaiting.isEmpty()) {
+            protocolError(QStringLiteral("Unexpected response"));
+            return false;
+        }
+        // e.g. "HTTP/1.1 200 OK"
+        const int firstSpace = line.indexOf(' ');
+        const int secondSpace = line.indexOf(' ', firstSpace + 1);
+        bool ok = false;
+        if (firstSpace > 0)
+            m_status = line.mid(firstSpace + 1, secondSpace < 0 ? -1 : secondSpace - firstSpace - 1).toInt(&ok);
+        if (!ok || !line.startsWith("HTTP/1.")) {
+            protocolError(QStringLiteral("Malformed status line"));
+            return false;
+        }
+        m_reason = secondSpace < 0 ? QByteArray() : line.mid(secondSpace + 1);
+        m_closeAfter = line.startsWith("HTTP/1.0");
+        m_state = Headers;
+        return true;
+    }
+    case Headers: {
+        if (line.isEmpty()) {
+            beginBody();
+            return true;
+        }
+        const int colon = line.indexOf(':');
+        if (colon <= 0) {
+            protocolError(QStringLiteral("Malformed header"));
+            return false;
+        }
+        const QByteArray name = line.left(colon).trimmed();
+        const QByteArray value = line.mid(colon + 1).trimmed();
+        const QByteArray lowerName = name.toLower();
+        if (lowerName == "content-length") {
+            m_remaining = value.toLongLong(&m_hasLength);
+        } else if (lowerName == "transfer-encoding") {
+            m_chunked = value.toLower().contains("chunked");
+        } else if (lowerName == "connection") {
+            const QByteArray lowerValue = value.toLower();
+            if (lowerValue.contains("close"))
+                m_closeAfter = true;
+            else if (lowerValue.contains("keep-alive"))
+                m_closeAfter = false;
+        }
+        m_headers.append(qMakePair(name, value));
+        return true;
+    }
+    case ChunkSize: {
+        const int extension = line.indexOf(';');
+        bool ok = false;
+        const qint64 size = (extension < 0 ? line : line.left(extension)).trimmed().toLongLong(&ok, 16);
+        if (!ok || size < 0) {
+            protocolError(QStringLiteral("Malformed chunk size"));
+            return false;
+        }
+        if (size == 0) {
+            m_state = ChunkTrailer;
+        } else {
+            m_remaining = size;
+            m_state = ChunkData;
+        }
+        return true;
+    }
+    case ChunkEnd:
+        if (!line.isEmpty()) {
+            protocolError(QStringLiteral("Malformed chunk"));
+            return false;
+        }
+        m_state = ChunkSize;
+        return true;
+    case ChunkTrailer:
+        if (line.isEmpty())
+            completeResponse();
+        return true;
+    default:
+        return false;
+    }
+}
+
+void HttpTransport::beginBody()
+{
+    // Interim responses (100 Continue) carry no body; the real one follows.
+    if (m_status >= 100 && m_status < 200) {
+        m_state = StatusLine;
+        m_headers.clear();
+        return;
+    }
+    const PendingRequest &current = m_awaiting.head();
+    if (current.reply && !current.reply->isFinished())
+        current.reply->setResponseHead(m_status, m_reason, m_headers);
+
+    if (!current.expectsBody || m_status == 204 || m_status == 304) {
+        completeResponse();
+    } else if (m_chunked) {
+        m_state = ChunkSize;
+    } else if (m_hasLength) {
+        if (m_remaining == 0)
+            completeResponse();
+        else
+            m_state = Body;
+    } else {
+        // No framing: the body runs until the server closes the connection.
+        m_state = BodyUntilClose;
+        m_closeAfter = true;
+    }
+}
+
+void HttpTransport::deliverBody(qint64 size)
+{
+    const PendingRequest &current = m_awaiting.head();
+    if (current.reply && !current.reply->isFinished())
+        current.reply->appendBody(m_buffer.left(int(size)));
+    m_buffer.remove(0, int(size));
+}
+
+void HttpTransport::completeResponse()
+{
+    const PendingRequest done = m_awaiting.dequeue();
+    const bool closeAfter = m_closeAfter;
+    m_state = StatusLine;
+    m_headers.clear();
+    m_remaining = 0;
+    m_chunked = false;
+    m_hasLength = false;
+    m_closeAfter = false;
+    if (done.reply)
+        done.reply->complete();
+    if (closeAfter)
+        resetConnection();
+    else
+        writePending();
+}
+
+// The connection is gone. GETs that never got an answer are replayed once on
+// a fresh connection; anything else may already have been applied and fails.
+void HttpTransport::onDisconnected()
+{
+    if (m_state == BodyUntilClose && !m_awaiting.isEmpty()) {
+        m_closeAfter = false;
+        completeResponse();
+    }
+    QQueue<PendingRequest> lost;
+    lost.swap(m_awaiting);
+    m_buffer.clear();
+    m_state = StatusLine;
+    m_headers.clear();
+    m_chunked = false;
+    m_hasLength = false;
+    m_closeAfter = false;
+
+    for (int i = lost.size() - 1; i >= 0; --i) {
+        PendingRequest &pending = lost[i];
+        if (!pending.reply || pending.reply->isFinished())
+            continue;
+        if (pending.pipelinable && !pending.resent) {
+            pending.resent = true;
+            m_unsent.prepend(pending);
+        } else {
+            pending.reply->fail(QNetworkReply::RemoteHostClosedError,
+                                QStringLiteral("Connection closed before the response arrived"));
+        }
+    }
+    if (!m_unsent.isEmpty())
+        ensureConnected();
+}
+
+void HttpTransport::onSocketError(QNetworkReply::NetworkError error, const QString &message)
+{
+    // A peer close also emits disconnected(), which replays what it can.
+    if (error == QNetworkReply::RemoteHostClosedError)
+        return;
+    qWarning() << "Syncthing connection error:" << message;
+    failAll(error, message);
+    if (socket()->isOpen())
+        resetConnection();
+}
+
+// A stalled response blocks everything pipelined behind it, so aborting the
+// head of the pipeline drops the connection and replays the rest.
+void HttpTransport::onReplyAborted(HttpReply *reply)
+{
+    if (!m_awaiting.isEmpty() && m_awaiting.head().reply == reply)
+        resetConnection();
+}
+
+void HttpTransport::resetConnection()
+{
+    if (m_localSocket)
+        m_localSocket->abort();
+    else
+        m_tcpSocket->abort();
+    onDisconnected();
+}
+
+void HttpTransport::protocolError(const QString &message)
+{
+    qWarning() << "Syncthing protocol error:" << message;
+    if (!m_awaiting.isEmpty() && m_awaiting.head().reply)
+        m_awaiting.head().reply->fail(QNetworkReply::ProtocolFailure, message);
+    resetConnection();
+}
+
+void HttpTransport::failAll(QNetworkReply::NetworkError error, const QString &message)
+{
+    QQueue<PendingRequest> doomed;
+    doomed.swap(m_awaiting);
+    doomed.append(m_unsent);
+    m_unsent.clear();
+    m_buffer.clear();
+    m_state = StatusLine;
+    for (const PendingRequest &pending : doomed) {
+        if (pending.reply)
+            pending.reply->fail(error, message);
+    }
+}
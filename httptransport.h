@@ -0,0 +1,112 @@
+#ifndef HTTPTRANSPORT_H
+#define HTTPTRANSPORT_H
+
+#include "apitransport.h"
+#include <QLocalSocket>
+#include <QTcpSocket>
+#include <QPointer>
+#include <QQueue>
+#include <QList>
+#include <QPair>
+
+class HttpTransport;
+
+// Reply handed out by HttpTransport. Looks like any other QNetworkReply to
+// ApiHandler: body bytes arrive through readyRead() and finished() fires once.
+class HttpReply : public QNetworkReply
+{
+    Q_OBJECT
+public:
+    HttpReply(const QNetworkRequest &request, const QByteArray &verb, HttpTransport *transport);
+
+    void abort() override;
+    qint64 bytesAvailable() const override;
+    bool isSequential() const override { return true; }
+
+    bool isAborted() const { return m_aborted; }
+    // Called by the transport as the response comes in.
+    void setResponseHead(int status, const QByteArray &reason,
+                         const QList<QPair<QByteArray, QByteArray>> &headers);
+    void appendBody(const QByteArray &data);
+    void complete();
+    void fail(QNetworkReply::NetworkError error, const QString &message);
+
+protected:
+    qint64 readData(char *data, qint64 maxSize) override;
+
+private:
+    static QNetworkReply::NetworkError errorForStatus(int status);
+
+    QPointer<HttpTransport> m_transport;
+    QByteArray m_body;      // Received but not yet read.
+    int m_status;
+    bool m_aborted;
+};
+
+// Minimal HTTP/1.1 client for the Syncthing REST API. Keeps one persistent
+// connection, over TCP or a Unix-domain socket, and pipelines GETs on it.
+// Any other method waits for the pipeline to drain and holds back everything
+// behind it until its own response has arrived.
+class HttpTransport : public ApiTransport
+{
+    Q_OBJECT
+public:
+    static HttpTransport *forLocalSocket(const QString &socketPath, QObject *parent = nullptr);
+    static HttpTransport *forTcp(const QString &host, quint16 port, QObject *parent = nullptr);
+
+    QNetworkReply *send(const QNetworkRequest &request, const QByteArray &verb,
+                        const QByteArray &body) override;
+    void setMaxPipelineDepth(int depth);   // Responses allowed outstanding at once.
+
+private:
+    friend class HttpReply;
+
+    explicit HttpTransport(QObject *parent);
+    QIODevice *socket() const;
+    bool isConnected() const;
+    void ensureConnected();
+    void writePending();
+    void onReadyRead();
+    void onDisconnected();
+    void onSocketError(QNetworkReply::NetworkError error, const QString &message);
+    void onReplyAborted(HttpReply *reply);
+    void resetConnection();
+    bool parseStep();
+    void beginBody();
+    void deliverBody(qint64 size);
+    void completeResponse();
+    void protocolError(const QString &message);
+    void failAll(QNetworkReply::NetworkError error, const QString &message);
+
+    struct PendingRequest {
+        QPointer<HttpReply> reply;
+        QByteArray wire;        // Serialized request line, headers and body.
+        bool pipelinable = false;
+        bool expectsBody = true;
+        bool resent = false;    // Already replayed once after a lost connection.
+    };
+    enum ParseState { StatusLine, Headers, Body, ChunkSize, ChunkData, ChunkEnd, ChunkTrailer, BodyUntilClose };
+
+    QLocalSocket *m_localSocket;
+    QTcpSocket *m_tcpSocket;
+    QString m_socketPath;
+    QString m_host;
+    quint16 m_port;
+    QQueue<PendingRequest> m_unsent;    // Waiting for the connection or the pipeline.
+    QQueue<PendingRequest> m_awaiting;  // Written, responses arrive in this order.
+    int m_maxPipelineDepth;
+    bool m_writeScheduled;              // A queued writePending() is pending.
+
+    // Response parser.
+    ParseState m_state;
+    QByteArray m_buffer;
+    int m_status;
+    QByteArray m_reason;
+    QList<QPair<QByteArray, QByteArray>> m_headers;
+    qint64 m_remaining;                 // Bytes left in the body or chunk.
+    bool m_chunked;
+    bool m_hasLength;
+    bool m_closeAfter;                  // Server asked to close after this response.
+};
+
+#endif // HTTPTRANSPORT_H
@@ -0,0 +1,214 @@
+#include "jsonstreamparser.h"
+#include <QJsonArray>
+#include <QJsonDocument>
+
+JsonStreamParser::JsonStreamParser(ElementHandler handler, int maxElementBytes)
+    : m_handler(std::move(handler)),
+      m_maxElementBytes(maxElementBytes),
+      m_state(BeforeRoot),
+      m_rootIsObject(false),
+      m_inMemberArray(false),
+      m_inString(false),
+      m_escape(false),
+      m_valueDepth(0),
+      m_elementCount(0),
+      m_bytesFed(0)
+{
+}
+
+bool JsonStreamParser::feed(const QByteArray &chunk)
+{
+    m_bytesFed += chunk.size();
+    for (const char c : chunk) {
+        if (!consume(c))
+            return false;
+    }
+    return m_state != Failed;
+}
+
+bool JsonStreamParser::finish()
+{
+    if (m_state == Failed)
+        return false;
+    if (m_state != Done)
+        return fail(QStringLiteral("Truncated JSON document"));
+    return true;
+}
+
+QString JsonStreamParser::errorString() const
+{
+    return m_error;
+}
+
+int JsonStreamParser::elementCount() const
+{
+    return m_elementCount;
+}
+
+int JsonStreamParser::bufferedBytes() const
+{
+    return m_element.size();
+}
+
+qint64 JsonStreamParser::bytesFed() const
+{
+    return m_bytesFed;
+}
+
+bool JsonStreamParser::consume(char c)
+{
+    const bool space = (c == ' ' || c == '\n' || c == '\r' || c == '\t');
+    switch (m_state) {
+    case BeforeRoot:
+        if (space)
+            return true;
+        if (c == '[') {
+            m_state = ExpectValue;
+            return true;
+        }
+        if (c == '{') {
+            m_rootIsObject = true;
+            m_state = ExpectKey;
+            return true;
+        }
+        return fail(QStringLiteral("Expected a JSON array or object"));
+
+    case ExpectKey:
+        if (space)
+            return true;
+        if (c == '"') {
+            m_keyRaw.clear();
+            m_state = InKey;
+            return true;
+        }
+        if (c == '}') {
+            m_state = Done;
+            return true;
+        }
+        return fail(QStringLiteral("Expected a member name"));
+
+    case InKey:
+        if (m_escape) {
+            m_escape = false;
+        } else if (c == '\\') {
+            m_escape = true;
+        } else if (c == '"') {
+            // Names rarely carry escapes; only those pay for a real parse.
+            if (m_keyRaw.contains('\\'))
+                m_key = QJsonDocument::fromJson("[\"" + m_keyRaw + "\"]").array().at(0).toString();
+            else
+                m_key = QString::fromUtf8(m_keyRaw);
+            m_state = ExpectColon;
+            return true;
+        }
+        m_keyRaw.append(c);
+        return true;
+
+    case ExpectColon:
+        if (space)
+            return true;
+        if (c == ':') {
+            m_state = ExpectValue;
+            return true;
+        }
+        return fail(QStringLiteral("Expected ':'"));
+
+    case ExpectValue:
+        if (space)
+            return true;
+        if (c == '[' && m_rootIsObject && !m_inMemberArray) {
+            m_inMemberArray = true;
+            return true;
+        }
+        if (c == ']' && (m_inMemberArray || !m_rootIsObject))
+            return closeArray();
+        m_element.clear();
+        m_element.append('[');
+        m_element.append(c);
+        m_inString = (c == '"');
+        m_valueDepth = (c == '[' || c == '{') ? 1 : 0;
+        m_state = InValue;
+        return true;
+
+    case InValue:
+        if (m_inString) {
+            if (m_escape)
+                m_escape = false;
+            else if (c == '\\')
+                m_escape = true;
+            else if (c == '"')
+                m_inString = false;
+        } else if (m_valueDepth == 0 && (c == ',' || c == ']' || c == '}')) {
+            if (!emitElement())
+                return false;
+            m_state = AfterValue;
+            return consume(c);
+        } else if (c == '"') {
+            m_inString = true;
+        } else if (c == '[' || c == '{') {
+            ++m_valueDepth;
+        } else if (c == ']' || c == '}') {
+            --m_valueDepth;
+        }
+        m_element.append(c);
+        if (m_maxElementBytes > 0 && m_element.size() > m_maxElementBytes)
+            return fail(QString("Element exceeds the %1 byte streaming limit").arg(m_maxElementBytes));
+        return true;
+
+    case AfterValue:
+        if (space)
+            return true;
+        if (c == ',') {
+            m_state = (m_rootIsObject && !m_inMemberArray) ? ExpectKey : ExpectValue;
+            return true;
+        }
+        if (c == ']' && (m_inMemberArray || !m_rootIsObject))
+            return closeArray();
+        if (c == '}' && m_rootIsObject && !m_inMemberArray) {
+            m_state = Done;
+            return true;
+        }
+        return fail(QString("Unexpected '%1' after a value").arg(QLatin1Char(c)));
+
+    case Done:
+        if (space)
+            return true;
+        return fail(QStringLiteral("Trailing data after the JSON document"));
+
+    case Failed:
+        return false;
+    }
+    return false;
+}
+
+bool JsonStreamParser::closeArray()
+{
+    if (m_inMemberArray) {
+        m_inMemberArray = false;
+        m_state = AfterValue;
+    } else {
+        m_state = Done;
+    }
+    return true;
+}
+
+bool JsonStreamParser::emitElement()
+{
+    m_element.append(']');
+    QJsonParseError error;
+    const QJsonDocument doc = QJsonDocument::fromJson(m_element, &error);
+    m_element.clear();
+    if (error.error != QJsonParseError::NoError)
+        return fail(QString("Malformed element: %1").arg(error.errorString()));
+    ++m_elementCount;
+    m_handler(m_rootIsObject ? m_key : QString(), doc.array().at(0));
+    return true;
+}
+
+bool JsonStreamParser::fail(const QString &message)
+{
+    m_state = Failed;
+    m_error = message;
+    m_element.clear();
+    return false;
+}
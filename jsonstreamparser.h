@@ -0,0 +1,57 @@
+#ifndef JSONSTREAMPARSER_H
+#define JSONSTREAMPARSER_H
+
+#include <QByteArray>
+#include <QString>
+#include <QJsonValue>
+#include <functional>
+
+// Incremental splitter for large REST replies. Bytes are fed as they arrive
+// and each element is parsed and handed out as soon as it is complete:
+//  - every item of a top-level array (key is empty),
+//  - every member of a top-level object, except that a member holding an
+//    array yields its items one by one under the member's name.
+// Only the element being assembled is buffered, never the whole body.
+class JsonStreamParser
+{
+public:
+    using ElementHandler = std::function<void(const QString &key, const QJsonValue &value)>;
+
+    // maxElementBytes caps one buffered element (0 means no cap).
+    explicit JsonStreamParser(ElementHandler handler, int maxElementBytes = 0);
+
+    // Returns false once the input is malformed or an element exceeds the cap.
+    bool feed(const QByteArray &chunk);
+    // Call after the last chunk. Returns false if the document was cut short.
+    bool finish();
+
+    QString errorString() const;
+    int elementCount() const;
+    int bufferedBytes() const;
+    qint64 bytesFed() const;
+
+private:
+    enum State { BeforeRoot, ExpectKey, InKey, ExpectColon, ExpectValue, InValue, AfterValue, Done, Failed };
+
+    bool consume(char c);
+    bool closeArray();
+    bool emitElement();
+    bool fail(const QString &message);
+
+    ElementHandler m_handler;
+    int m_maxElementBytes;
+    State m_state;
+    bool m_rootIsObject;
+    bool m_inMemberArray;   // Streaming the items of an object member.
+    bool m_inString;
+    bool m_escape;
+    int m_valueDepth;       // Nesting inside the element being assembled.
+    QByteArray m_keyRaw;
+    QString m_key;
+    QByteArray m_element;   // Raw element, wrapped in '[' for parsing.
+    int m_elementCount;
+    qint64 m_bytesFed;
+    QString m_error;
+};
+
+#endif // JSONSTREAMPARSER_H
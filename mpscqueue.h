@@ -0,0 +1,63 @@
+#ifndef MPSCQUEUE_H
+#define MPSCQUEUE_H
+
+#include <atomic>
+#include <utility>
+
+// Unbounded multi-producer, single-consumer queue after Dmitry Vyukov's
+// node-based design. push() is wait-free: one atomic exchange and one store,
+// callable from any thread. pop() belongs to a single consumer thread.
+// A push that is still linking its node may be missed by a concurrent pop();
+// the producer's subsequent wake-up covers that window.
+template <typename T>
+class MpscQueue
+{
+public:
+    MpscQueue()
+        : m_head(new Node),
+          m_tail(m_head.load())
+    {
+    }
+
+    ~MpscQueue()
+    {
+        T discarded;
+        while (pop(discarded)) {}
+        delete m_tail;
+    }
+
+    MpscQueue(const MpscQueue&) = delete;
+    MpscQueue& operator=(const MpscQueue&) = delete;
+
+    void push(T value)
+    {
+        Node *node = new Node;
+        node->value = std::move(value);
+        Node *previous = m_head.exchange(node);
+        previous->next.store(node);
+    }
+
+    bool pop(T &out)
+    {
+        Node *tail = m_tail;
+        Node *next = tail->next.load();
+        if (!next)
+            return false;
+        // `next` becomes the new stub; its value is moved out, not copied.
+        out = std::move(next->value);
+        m_tail = next;
+        delete tail;
+        return true;
+    }
+
+private:
+    struct Node {
+        std::atomic<Node*> next{nullptr};
+        T value;
+    };
+
+    std::atomic<Node*> m_head;  // Producers append here.
+    Node *m_tail;               // Consumer's stub node.
+};
+
+#endif // MPSCQUEUE_H
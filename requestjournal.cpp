@@ -0,0 +1,204 @@
+#include "requestjournal.h"
+#include <QDateTime>
+#include <QDebug>
+#include <QDir>
+#include <QFileInfo>
+#include <QHash>
+#include <QJsonDocument>
+#include <QJsonObject>
+#include <QMutexLocker>
+#include <QSaveFile>
+#ifdef Q_OS_UNIX
+#include <unistd.h>
+#endif
+
+// Once every entry is settled, a journal past this size starts over.
+static const qint64 TruncateBytes = 1024 * 1024;
+
+static const char *const MethodNames[] = {"GET", "POST", "PATCH", "PUT", "DELETE"};
+
+RequestJournal::RequestJournal(const QString &path)
+    : m_path(path),
+      m_file(path),
+      m_writeScheduled(false),
+      m_nextId(1)
+{
+    m_writer.setMaxThreadCount(1);
+}
+
+RequestJournal::~RequestJournal()
+{
+    flush();
+}
+
+bool RequestJournal::open(qint64 maxAgeSecs, QVector<Entry> &pending)
+{
+    QDir().mkpath(QFileInfo(m_path).absolutePath());
+    QHash<quint64, int> indexById;
+    QVector<Entry> entries;
+    QFile existing(m_path);
+    if (existing.open(QIODevice::ReadOnly)) {
+        while (!existing.atEnd()) {
+            const QJsonObject record = QJsonDocument::fromJson(existing.readLine()).object();
+            const quint64 id = quint64(record.value("id").toDouble());
+            if (id == 0)
+                continue;  // Torn or foreign line.
+            m_nextId = qMax(m_nextId, id + 1);
+            const QString op = record.value("op").toString();
+            if (op == QLatin1String("done")) {
+                const int index = indexById.take(id);
+                if (index > 0)
+                    entries[index - 1].id = 0;
+            } else if (op == QLatin1String("add")) {
+                Entry entry;
+                entry.id = id;
+                entry.recordedAtSecs = qint64(record.value("t").toDouble());
+                entry.intent = record.value("intent").toString();
+                const QString method = record.value("method").toString();
+                for (int m = 0; m <= ApiRequest::DELETE_; ++m) {
+                    if (method == QLatin1String(MethodNames[m]))
+                        entry.method = ApiRequest::HttpMethod(m);
+                }
+                entry.url = QUrl(record.value("url").toString());
+                entry.orderingKey = record.value("key").toString();
+                entry.payload = QByteArray::fromBase64(record.value("body").toString().toLatin1());
+                entries.append(entry);
+                indexById.insert(id, entries.size());
+            }
+        }
+        existing.close();
+    }
+
+    // Compact: keep the unsettled, recent entries only.
+    const qint64 oldestSecs = QDateTime::currentSecsSinceEpoch() - maxAgeSecs;
+    QSaveFile compacted(m_path);
+    if (!compacted.open(QIODevice::WriteOnly)) {
+        m_error = compacted.errorString();
+        return false;
+    }
+    for (const Entry &entry : entries) {
+        if (entry.id == 0)
+            continue;
+        if (entry.recordedAtSecs < oldestSecs) {
+            qWarning() << "Dropping stale journaled request:" << entry.intent;
+            continue;
+        }
+        compacted.write(encode(entry));
+        pending.append(entry);
+    }
+    if (!compacted.commit()) {
+        m_error = compacted.errorString();
+        return false;
+    }
+    if (!m_file.open(QIODevice::WriteOnly | QIODevice::Append)) {
+        m_error = m_file.errorString();
+        return false;
+    }
+    m_stats.open = pending.size();
+    return true;
+}
+
+QString RequestJournal::errorString() const
+{
+    return m_error;
+}
+
+QByteArray RequestJournal::encode(const Entry &entry)
+{
+    QJsonObject record;
+    record["op"] = "add";
+    record["id"] = double(entry.id);
+    record["t"] = double(entry.recordedAtSecs);
+    record["intent"] = entry.intent;
+    record["method"] = MethodNames[entry.method];
+    record["url"] = entry.url.toString();
+    record["key"] = entry.orderingKey;
+    record["body"] = QString::fromLatin1(entry.payload.toBase64());
+    return QJsonDocument(record).toJson(QJsonDocument::Compact) + '\n';
+}
+
+quint64 RequestJournal::record(const ApiRequest &req)
+{
+    Entry entry;
+    {
+        QMutexLocker locker(&m_mutex);
+        entry.id = m_nextId++;
+        ++m_stats.recorded;
+        ++m_stats.open;
+    }
+    entry.recordedAtSecs = QDateTime::currentSecsSinceEpoch();
+    entry.intent = req.journalIntent;
+    entry.method = req.method;
+    entry.url.setPath(req.url.path());
+    entry.url.setQuery(req.url.query());
+    entry.orderingKey = req.orderingKey;
+    entry.payload = req.payload;
+    append(encode(entry));
+    return entry.id;
+}
+
+void RequestJournal::settle(quint64 id)
+{
+    {
+        QMutexLocker locker(&m_mutex);
+        ++m_stats.settled;
+        --m_stats.open;
+    }
+    append("{\"op\":\"done\",\"id\":" + QByteArray::number(id) + "}\n");
+}
+
+void RequestJournal::append(const QByteArray &line)
+{
+    QMutexLocker locker(&m_mutex);
+    m_buffer += line;
+    if (m_writeScheduled)
+        return;  // The running write picks it up.
+    m_writeScheduled = true;
+    m_writer.start([this]() { writePending(); });
+}
+
+// Records that arrive while a write and its fsync are in progress are
+// collected into the next write.
+void RequestJournal::writePending()
+{
+    QMutexLocker fileLocker(&m_fileMutex);
+    for (;;) {
+        QByteArray data;
+        bool truncate = false;
+        {
+            QMutexLocker locker(&m_mutex);
+            if (m_buffer.isEmpty()) {
+                m_writeScheduled = false;
+                return;
+            }
+            data.swap(m_buffer);
+            truncate = m_stats.open == 0 && m_file.size() > TruncateBytes;
+        }
+        if (!m_file.isOpen())
+            continue;  // Never opened: records are dropped.
+        // Every entry recorded so far is settled: neither the file nor
+        // this batch holds anything a restart would still need.
+        if (truncate)
+            m_file.resize(0);
+        else
+            m_file.write(data);
+        m_file.flush();
+#ifdef Q_OS_UNIX
+        ::fsync(m_file.handle());
+#endif
+        QMutexLocker locker(&m_mutex);
+        ++m_stats.commits;
+    }
+}
+
+void RequestJournal::flush()
+{
+    m_writer.waitForDone();
+    writePending();
+}
+
+RequestJournal::Stats RequestJournal::stats() const
+{
+    QMutexLocker locker(&m_mutex);
+    return m_stats;
+}
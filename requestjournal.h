@@ -0,0 +1,72 @@
+#ifndef REQUESTJOURNAL_H
+#define REQUESTJOURNAL_H
+
+#include <QString>
+#include <QByteArray>
+#include <QUrl>
+#include <QVector>
+#include <QFile>
+#include <QMutex>
+#include <QThreadPool>
+#include <atomic>
+#include "apihandler.h"
+
+// Append-only, crash-safe log of mutating requests, so a change that is
+// still queued when the wrapper stops is sent again on the next start.
+// One JSON object per line:
+//   {"op":"add","id":7,"t":1700000000,"intent":"...","method":"POST",
+//    "url":"/rest/...","key":"mutation /rest/...","body":"<base64>"}
+//   {"op":"done","id":7}
+// Records are buffered and written by a single background writer. Each
+// write takes everything recorded since the previous one and ends with one
+// fsync (group commit), so callers never wait for the disk. A torn last
+// line, left by a crash mid-write, is skipped on open.
+class RequestJournal
+{
+public:
+    struct Entry {
+        quint64 id = 0;
+        qint64 recordedAtSecs = 0;
+        QString intent;
+        ApiRequest::HttpMethod method = ApiRequest::POST;
+        QUrl url;               // Path and query only; the base URL may change.
+        QString orderingKey;
+        QByteArray payload;
+    };
+    using Stats = ApiHandler::JournalStats;
+
+    explicit RequestJournal(const QString &path);
+    ~RequestJournal();          // Writes out whatever is still buffered.
+    RequestJournal(const RequestJournal&) = delete;
+    RequestJournal& operator=(const RequestJournal&) = delete;
+
+    // Read the journal, rewrite it with only the unsettled entries and return
+    // those, oldest first. Entries older than maxAgeSecs are dropped.
+    bool open(qint64 maxAgeSecs, QVector<Entry> &pending);
+    QString errorString() const;
+
+    // Both are cheap and never touch the disk themselves.
+    quint64 record(const ApiRequest &req);  // Returns the entry id.
+    void settle(quint64 id);
+    // Block until everything recorded so far is durable.
+    void flush();
+    Stats stats() const;
+
+private:
+    void append(const QByteArray &line);
+    void writePending();
+    static QByteArray encode(const Entry &entry);
+
+    QString m_path;
+    QString m_error;
+    QFile m_file;
+    QMutex m_fileMutex;         // One writer at a time.
+    mutable QMutex m_mutex;     // Guards the fields below.
+    QByteArray m_buffer;        // Recorded, not yet written.
+    bool m_writeScheduled;
+    quint64 m_nextId;
+    Stats m_stats;
+    QThreadPool m_writer;       // Single thread that writes and syncs.
+};
+
+#endif // REQUESTJOURNAL_H
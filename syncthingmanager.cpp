@@ -2,6 +2,8 @@
 #include "configHandler.h"
 #include "filehandler.h"
 #include "validater.h"
+#include "httptransport.h"
+#include "apicoroutine.h"
 
 #include <QHostAddress>
 #include <QJsonDocument>
@@ -9,9 +11,34 @@
 #include <QDebug>
 #include <QUuid>
 #include <QFileInfo>
+#include <QLoggingCategory>
+
+// Profiling output, off unless enabled through QT_LOGGING_RULES.
+Q_LOGGING_CATEGORY(SyncthingCostLog, "syncthing.cost", QtWarningMsg)
+
+// Poll keys, also used as unchangedKey; forgotten when an accept fails so
+// the entry is offered again on the next poll.
+static const char PendingDevicesPoll[] = "pending-devices-poll";
+static const char PendingFoldersPoll[] = "pending-folders-poll";
+
+// Drops accepted entries the daemon no longer lists as pending.
+static void keepPending(QSet<QString> &accepted, const QJsonObject &pending)
+{
+    const QSet<QString> ids = accepted;
+    for (const QString &id : ids) {
+        if (!pending.contains(id))
+            accepted.remove(id);
+    }
+}
 
 static SyncthingManager* instance = nullptr;
 
+// Fixed PATCH bodies come from static data instead of a QJsonDocument round trip.
+static QByteArray pausedPayload(bool paused)
+{
+    return paused ? QByteArrayLiteral("{\"paused\":true}") : QByteArrayLiteral("{\"paused\":false}");
+}
+
 
 SyncthingManager::~SyncthingManager()
 {
@@ -24,6 +51,37 @@ SyncthingManager::SyncthingManager()
     api = ApiHandler::getInstance();
     api->setApiKey(co->apiKey());
     api->setBaseUrl(co->baseUrl());
+    // QNetworkAccessManager cannot reach a GUI bound to a Unix socket.
+    if (!co->guiSocketPath().isEmpty())
+        api->setTransport(HttpTransport::forLocalSocket(co->guiSocketPath()));
+    // Keep reply handling off the UI thread. Results still reach this
+    // object's callbacks on its own thread, so signals behave as before.
+    if (co->getApiThreaded())
+        api->startWorkerThread();
+    // Full-config round trips are slow; keep them from taking every slot.
+    api->setEndpointInFlightLimit(QString(CONFIG), 2);
+    // Each config write makes Syncthing reload its config; accepting many
+    // clients at once must not turn into a burst of reloads.
+    api->setRateLimit(ApiRequest::POST, QString(CONFIG), 1, 3);
+    api->setRateLimit(ApiRequest::PUT, QString(CONFIGDEVICE), 2, 5);
+    // Reads that several flows repeat within one poll cycle.
+    api->setCacheTtl(QString(CONFIG), 1000);
+    api->setCacheTtl(QString(CONNECTEDDEVICE), 2000);
+    api->setCacheTtl(QString(STATUS), 2000);
+    api->setCacheTtl(QString(DISCOVERY), 5000);
+    // The big bodies; worth it when the GUI is reached over the LAN.
+    api->setCompression(QString(CONFIG), true);
+    api->setCompression(QString(EVENTS), true);
+    api->setCompression(QString(SYNCTHINGLOG), true);
+    // Cheap, side-effect-free status reads the UI waits on; a stray slow
+    // one should not hold up a refresh.
+    api->setHedging(QString(CONNECTEDDEVICE), true);
+    api->setHedging(QString(STATUS), true);
+    // Finish config changes a restart interrupted before redoing discovery.
+    if (co->getRequestJournal())
+        api->setJournal(QString(CONFIGDIR) + "api-journal.log");
+    // Full configs and event bursts take milliseconds to parse.
+    api->setDecodeOffload(32 * 1024);
     IS_SERVER = co->getWrapperIsServer();
     if(IS_SERVER)
         shareLocalFolderIfNeeded(QString(UPDATEPATH));
@@ -68,65 +126,94 @@ SyncthingManager* SyncthingManager::getInstance()
 void SyncthingManager::getSystemLog()
 {
     // Prepare URLs
-    QUrl logUrl = api->m_baseUrl;
-    logUrl.setPath(QString(SYNCTHINGLOG));
-    QUrl healthUrl = api->m_baseUrl;
-    healthUrl.setPath(QString(HEALTH));
+    QUrl logUrl = api->endpointUrl(Endpoint::SystemLog);
 
     // Step 1: Fetch system log
     ApiRequest logReq;
     logReq.method = ApiRequest::GET;
     logReq.url    = logUrl;
-    logReq.callback = [this, healthUrl](QNetworkReply *replyLog) {
-        if (replyLog->error() != QNetworkReply::NoError) {
-            emit globalError(QString("Failed to fetch system log: %1")
-                             .arg(replyLog->errorString()));
-            replyLog->deleteLater();
+    // The log can run to megabytes; stream it and keep only the newest
+    // messages, so neither the raw body nor all of it parsed is ever held.
+    static const int MaxLogMessages = 1000;
+    QSharedPointer<QJsonObject> combined = QSharedPointer<QJsonObject>::create();
+    QSharedPointer<QQueue<QJsonValue>> messages = QSharedPointer<QQueue<QJsonValue>>::create();
+    logReq.onElement = [combined, messages](const QString &key, const QJsonValue &value) {
+        if (key == QLatin1String("messages")) {
+            messages->enqueue(value);
+            if (messages->size() > MaxLogMessages)
+                messages->dequeue();
+        } else {
+            combined->insert(key, value);
+        }
+    };
+    logReq.onResult = [this, logUrl, combined, messages](const ApiResult &resultLog) {
+        if (resultLog.error == QNetworkReply::UnknownContentError
+                && combined->isEmpty() && messages->isEmpty()) {
+            // Not JSON: fetch it again whole and keep it as raw text.
+            ApiRequest rawReq;
+            rawReq.method = ApiRequest::GET;
+            rawReq.url    = logUrl;
+            rawReq.onResult = [this](const ApiResult &rawResult) {
+                if (!rawResult.ok()) {
+                    emit globalError(QString("Failed to fetch system log: %1")
+                                     .arg(rawResult.errorString));
+                    return;
+                }
+                QJsonObject raw;
+                if (rawResult.document.isObject())
+                    raw = rawResult.document.object();
+                else
+                    raw["log"] = QString::fromUtf8(rawResult.body);
+                writeSystemLog(raw);
+            };
+            api->enqueueRequest(std::move(rawReq));
             return;
         }
-
-        // Parse the log JSON (or treat as raw if not JSON)
-        QByteArray logData = replyLog->readAll();
-        replyLog->deleteLater();
-        QJsonDocument logDoc = QJsonDocument::fromJson(logData);
-        QJsonObject combined;
-        if (logDoc.isObject()) {
-            combined = logDoc.object();
-        } else {
-            combined["log"] = QString::fromUtf8(logData);
+        if (!resultLog.ok()) {
+            emit globalError(QString("Failed to fetch system log: %1")
+                             .arg(resultLog.errorString));
+            return;
         }
+        QJsonArray kept;
+        while (!messages->isEmpty())
+            kept.append(messages->dequeue());
+        combined->insert("messages", kept);
+        writeSystemLog(*combined);
+    };
+    api->enqueueRequest(std::move(logReq));
+}
 
-        // Step 2: Fetch health to get discoveryErrors
-        ApiRequest healthReq;
-        healthReq.method = ApiRequest::GET;
-        healthReq.url    = healthUrl;
-        healthReq.callback = [this, combined](QNetworkReply *replyHealth) mutable {
-            if (replyHealth->error() == QNetworkReply::NoError) {
-                QJsonDocument healthDoc = QJsonDocument::fromJson(replyHealth->readAll());
-                if (healthDoc.isObject()) {
-                    QJsonObject healthObj = healthDoc.object();
-                    // Append discoveryErrors if present
-                    if (healthObj.contains("discoveryErrors")) {
-                        combined["discoveryErrors"] = healthObj.value("discoveryErrors");
-                    }
+// Step 2 and 3 of getSystemLog(): add discoveryErrors from the health
+// endpoint and write the result out.
+void SyncthingManager::writeSystemLog(QJsonObject combined)
+{
+    ApiRequest healthReq;
+    healthReq.method = ApiRequest::GET;
+    healthReq.url    = api->endpointUrl(Endpoint::Health);
+    healthReq.onResult = [this, combined](const ApiResult &healthResult) mutable {
+        if (healthResult.ok()) {
+            const QJsonDocument &healthDoc = healthResult.document;
+            if (healthDoc.isObject()) {
+                QJsonObject healthObj = healthDoc.object();
+                // Append discoveryErrors if present
+                if (healthObj.contains("discoveryErrors")) {
+                    combined["discoveryErrors"] = healthObj.value("discoveryErrors");
                 }
-            } else {
-                emit globalError(QString("Failed to fetch health info: %1")
-                                 .arg(replyHealth->errorString()));
             }
-            replyHealth->deleteLater();
+        } else {
+            emit globalError(QString("Failed to fetch health info: %1")
+                             .arg(healthResult.errorString));
+        }
 
-            // Step 3: Write merged JSON to file
-            bool ok = FileHandler::writeJsonToFile(combined);
-            if (ok) {
-                qDebug() << "[SyncthingManager] System log + discovery errors written.";
-            } else {
-                qWarning() << "[SyncthingManager] Failed to write system log file.";
-            }
-        };
-        api->enqueueRequest(healthReq);
+        // Step 3: Write merged JSON to file
+        bool ok = FileHandler::writeJsonToFile(combined);
+        if (ok) {
+            qDebug() << "[SyncthingManager] System log + discovery errors written.";
+        } else {
+            qWarning() << "[SyncthingManager] Failed to write system log file.";
+        }
     };
-    api->enqueueRequest(logReq);
+    api->enqueueRequest(std::move(healthReq));
 }
 
 
@@ -172,6 +259,8 @@ void SyncthingManager::startHealthChecks(int intervalMs)
 
 void SyncthingManager::stopHealthChecks()
 {
+    api->cancel(m_healthToken);
+    m_healthCheckPending = false;
     if (m_healthTimer.isActive()) {
         m_healthTimer.stop();
         qDebug() << "[SyncthingManager] Health checks stopped.";
@@ -185,6 +274,7 @@ void SyncthingManager::stopHealthChecks()
 void SyncthingManager::startEventPolling(int intervalMs)
 {
     if (!m_eventsTimer.isActive()) {
+        m_eventsToken = ApiCancelToken::create();
         m_eventsTimer.start(intervalMs);
         qDebug() << "[SyncthingManager] Event polling started, interval:" << intervalMs << "ms";
     }
@@ -192,6 +282,7 @@ void SyncthingManager::startEventPolling(int intervalMs)
 
 void SyncthingManager::stopEventPolling()
 {
+    api->cancel(m_eventsToken);
     if (m_eventsTimer.isActive()) {
         m_eventsTimer.stop();
         qDebug() << "[SyncthingManager] Event polling stopped.";
@@ -200,26 +291,25 @@ void SyncthingManager::stopEventPolling()
 
 void SyncthingManager::removeDevice(const QString &deviceId)
 {
-    QUrl reqUrl = api->m_baseUrl;
-    reqUrl.setPath(QString("/rest/config/devices/%1").arg(deviceId));
+    QUrl reqUrl = api->endpointUrl(Endpoint::ConfigDevices, deviceId);
 
     ApiRequest req;
     req.method = ApiRequest::DELETE_;
     req.url = reqUrl;
-    req.callback = [this, deviceId](QNetworkReply *reply) {
-        int status = reply->attribute(QNetworkRequest::HttpStatusCodeAttribute).toInt();
-        if (reply->error() == QNetworkReply::NoError && status < 400) {
+    req.onResult = [this, deviceId](const ApiResult &result) {
+        int status = result.httpStatus;
+        if (result.ok() && status < 400) {
             qDebug() << "Device removed:" << deviceId;
+            m_acceptedDevices.remove(deviceId);
             emit deviceRemoved(deviceId);
         }
     };
-    api->enqueueRequest(req);
+    api->enqueueRequest(std::move(req));
 }
 
 void SyncthingManager::pauseDevice(const QString &deviceId)
 {
-    QUrl reqUrl = api->m_baseUrl;
-    reqUrl.setPath(QString(PAUSEDEVICE));
+    QUrl reqUrl = api->endpointUrl(Endpoint::PauseDevice);
     QUrlQuery query;
     query.addQueryItem("device", deviceId);
     reqUrl.setQuery(query);
@@ -227,19 +317,18 @@ void SyncthingManager::pauseDevice(const QString &deviceId)
     ApiRequest req;
     req.method = ApiRequest::POST;
     req.url = reqUrl;
-    req.callback = [this, deviceId](QNetworkReply *reply) {
-        if (reply->error() == QNetworkReply::NoError) {
+    req.onResult = [this, deviceId](const ApiResult &result) {
+        if (result.ok()) {
             qDebug() << "Device paused:" << deviceId;
             emit devicePaused(deviceId);
         }
     };
-    api->enqueueRequest(req);
+    api->enqueueRequest(std::move(req));
 }
 
 void SyncthingManager::resumeDevice(const QString &deviceId)
 {
-    QUrl reqUrl = api->m_baseUrl;
-    reqUrl.setPath(QString(RESUMEDEVICE));
+    QUrl reqUrl = api->endpointUrl(Endpoint::ResumeDevice);
     QUrlQuery query;
     query.addQueryItem("device", deviceId);
     reqUrl.setQuery(query);
@@ -247,104 +336,108 @@ void SyncthingManager::resumeDevice(const QString &deviceId)
     ApiRequest req;
     req.method = ApiRequest::POST;
     req.url = reqUrl;
-    req.callback = [this, deviceId](QNetworkReply *reply) {
-        if (reply->error() == QNetworkReply::NoError) {
+    req.onResult = [this, deviceId](const ApiResult &result) {
+        if (result.ok()) {
             qDebug() << "Device resumed:" << deviceId;
             emit deviceResumed(deviceId);
         }
     };
-    api->enqueueRequest(req);
+    api->enqueueRequest(std::move(req));
 }
 
 void SyncthingManager::pauseFolder(const QString &folderId)
 {
-    QUrl reqUrl = api->m_baseUrl;
-    reqUrl.setPath(QString(QString(CONFIGFOLDER)+"/"+folderId));
+    QUrl reqUrl = api->endpointUrl(Endpoint::ConfigFolders, folderId);
 
-    QJsonObject payloadObj;
-    payloadObj["paused"] = true;
-    QByteArray payload = QJsonDocument(payloadObj).toJson();
+    QByteArray payload = pausedPayload(true);
 
     ApiRequest req;
     req.method = ApiRequest::PATCH;
     req.url = reqUrl;
     req.payload = payload;
-    req.callback = [this, folderId](QNetworkReply *reply) {
-        if (reply->error() == QNetworkReply::NoError) {
+    req.onResult = [this, folderId](const ApiResult &result) {
+        if (result.ok()) {
             qDebug() << "Folder paused:" << folderId;
             emit folderPaused(folderId);
         }
     };
-    api->enqueueRequest(req);
+    api->enqueueRequest(std::move(req));
 }
 
 void SyncthingManager::resumeFolder(const QString &folderId)
 {
-    QUrl reqUrl = api->m_baseUrl;
-    reqUrl.setPath(QString(QString(CONFIGFOLDER)+"/"+folderId));
+    QUrl reqUrl = api->endpointUrl(Endpoint::ConfigFolders, folderId);
 
-    QJsonObject payloadObj;
-    payloadObj["paused"] = false;
-    QByteArray payload = QJsonDocument(payloadObj).toJson();
+    QByteArray payload = pausedPayload(false);
 
     ApiRequest req;
     req.method = ApiRequest::PATCH;
     req.url = reqUrl;
     req.payload = payload;
-    req.callback = [this, folderId](QNetworkReply *reply) {
-        if (reply->error() == QNetworkReply::NoError) {
+    req.onResult = [this, folderId](const ApiResult &result) {
+        if (result.ok()) {
             qDebug() << "Folder resumed:" << folderId;
             emit folderResumed(folderId);
         }
     };
-    api->enqueueRequest(req);
+    api->enqueueRequest(std::move(req));
 }
 
 void SyncthingManager::querySystemStatus()
 {
-    QUrl reqUrl = api->m_baseUrl;
-    reqUrl.setPath(QString(STATUS));
+    QUrl reqUrl = api->endpointUrl(Endpoint::SystemStatus);
 
     ApiRequest req;
     req.method = ApiRequest::GET;
     req.url = reqUrl;
-    req.callback = [this](QNetworkReply *reply) {
-        if (reply->error() == QNetworkReply::NoError) {
-            QByteArray data = reply->readAll();
-            QJsonDocument doc = QJsonDocument::fromJson(data);
-            if (doc.isObject()) {
-                QJsonObject status = doc.object();
-                qDebug() << "System Status:" << QJsonDocument(status).toJson(QJsonDocument::Compact);
-                emit systemStatusReceived(status);
-            }
+    req.onResult = [this](const ApiResult &result) {
+        if (result.ok() && result.document.isObject()) {
+            QJsonObject status = result.document.object();
+            qDebug() << "System Status:" << result.body;
+            emit systemStatusReceived(status);
         }
     };
-    api->enqueueRequest(req);
+    api->enqueueRequest(std::move(req));
 }
 
 // ----- Health Monitoring and Ping Checks -----
 
 void SyncthingManager::performHealthCheck()
 {
-    QUrl healthUrl = api->m_baseUrl;
-    healthUrl.setPath(QString(HEALTH));  // "/rest/noauth/health"
+    // A newer check supersedes whatever the previous one left behind. A
+    // cancelled check reports nothing, so report the one that never finished.
+    if (m_healthCheckPending)
+        reportHealth(false, QStringLiteral("syncthing is down"));
+    api->cancel(m_healthToken);
+    m_healthToken = ApiCancelToken::create();
+    const ApiCancelToken token = m_healthToken;
+    // Expire well before the next tick, so a slow daemon is reported down
+    // through the deadline rather than cancelled without a word.
+    const int interval = m_healthTimer.interval();
+    const QDeadlineTimer deadline = m_healthTimer.isActive()
+            ? QDeadlineTimer(qMax(1, interval - qMin(interval / 4, 1000)))
+            : QDeadlineTimer(QDeadlineTimer::Forever);
+    m_healthCheckPending = true;
+
+    QUrl healthUrl = api->endpointUrl(Endpoint::Health);
 
     ApiRequest healthReq;
     healthReq.method = ApiRequest::GET;
     healthReq.url    = healthUrl;
-    healthReq.callback = [this](QNetworkReply *replyHealth) {
-        if (replyHealth->error() != QNetworkReply::NoError) {
-            replyHealth->deleteLater();
-            emit systemHealthCheck(false, QStringLiteral("syncthing is down"));
+    healthReq.coalesceKey = QStringLiteral("health-check");
+    healthReq.cancelToken = token;
+    healthReq.deadline = deadline;
+    healthReq.onResult = [this, token, deadline](const ApiResult &healthResult) {
+        if (healthResult.superseded || token.isCancelled())
+            return;  // A newer check reports instead.
+        if (!healthResult.ok()) {
+            reportHealth(false, QStringLiteral("syncthing is down"));
             return;
         }
 
-        QByteArray hData = replyHealth->readAll();
-        replyHealth->deleteLater();
-        QJsonParseError hErr;
-        QJsonDocument hDoc = QJsonDocument::fromJson(hData, &hErr);
-        if (hErr.error != QJsonParseError::NoError || !hDoc.isObject()) {
-            emit systemHealthCheck(false, QStringLiteral("syncthing is down"));
+        const QJsonDocument &hDoc = healthResult.document;
+        if (healthResult.parseError.error != QJsonParseError::NoError || !hDoc.isObject()) {
+            reportHealth(false, QStringLiteral("syncthing is down"));
             return;
         }
 
@@ -353,70 +446,77 @@ void SyncthingManager::performHealthCheck()
 
         // Healthy case now uses empty reason
         if (state == QLatin1String("OK")) {
-            emit systemHealthCheck(true, QString());
+            reportHealth(true, QString());
             return;
         }
 
         // Non‑OK: fetch full status for discoveryErrors
-        QUrl statusUrl = api->m_baseUrl;
-        statusUrl.setPath(QString(STATUS));  // "/rest/system/status"
+        QUrl statusUrl = api->endpointUrl(Endpoint::SystemStatus);
 
         ApiRequest statusReq;
         statusReq.method = ApiRequest::GET;
         statusReq.url    = statusUrl;
-        statusReq.callback = [this, state](QNetworkReply *replyStatus) {
+        statusReq.coalesceKey = QStringLiteral("health-check-status");
+        statusReq.cancelToken = token;
+        statusReq.deadline = deadline;
+        statusReq.onResult = [this, state, token](const ApiResult &statusResult) {
+            if (statusResult.superseded || token.isCancelled())
+                return;
             QString errorInfo;
 
-            if (replyStatus->error() == QNetworkReply::NoError) {
-                QJsonDocument sDoc = QJsonDocument::fromJson(replyStatus->readAll());
-                if (sDoc.isObject()) {
-                    QJsonObject sObj = sDoc.object();
-                    if (sObj.contains("discoveryErrors") &&
-                            sObj.value("discoveryErrors").isObject()) {
-                        QJsonObject errs = sObj.value("discoveryErrors").toObject();
-                        if (!errs.isEmpty()) {
-                            errorInfo = QString::fromUtf8(
-                                        QJsonDocument(errs).toJson(QJsonDocument::Compact));
-                        }
+            if (statusResult.ok() && statusResult.document.isObject()) {
+                QJsonObject sObj = statusResult.document.object();
+                if (sObj.contains("discoveryErrors") &&
+                        sObj.value("discoveryErrors").isObject()) {
+                    QJsonObject errs = sObj.value("discoveryErrors").toObject();
+                    if (!errs.isEmpty()) {
+                        errorInfo = QString::fromUtf8(
+                                    QJsonDocument(errs).toJson(QJsonDocument::Compact));
                     }
                 }
             }
-            replyStatus->deleteLater();
 
             if (errorInfo.isEmpty())
                 errorInfo = state;
 
-            emit systemHealthCheck(false, errorInfo);
+            reportHealth(false, errorInfo);
         };
 
-        api->enqueueRequest(statusReq);
+        api->enqueueRequest(std::move(statusReq));
     };
 
-    api->enqueueRequest(healthReq);
+    api->enqueueRequest(std::move(healthReq));
+}
+
+void SyncthingManager::reportHealth(bool isHealthy, const QString &reason)
+{
+    m_healthCheckPending = false;
+    emit systemHealthCheck(isHealthy, reason);
 }
 
 void SyncthingManager::performPingCheck()
 {
-    QUrl reqUrl = api->m_baseUrl;
-    reqUrl.setPath(QString(PING));
+    QUrl reqUrl = api->endpointUrl(Endpoint::Ping);
 
     ApiRequest req;
     req.method = ApiRequest::GET;
     req.url = reqUrl;
-    req.callback = [this](QNetworkReply *reply) {
-        bool alive = (reply->error() == QNetworkReply::NoError);
+    req.coalesceKey = QStringLiteral("ping-check");
+    req.onResult = [this](const ApiResult &result) {
+        if (result.superseded)
+            return;  // Queued behind a slow daemon; the newer ping reports.
+        bool alive = result.ok();
         qDebug() << "[Ping Check]:" << (alive ? "Alive" : "Dead");
         emit pingPongStatus(alive);
     };
-    api->enqueueRequest(req);
+    api->enqueueRequest(std::move(req));
 }
 
 
 void SyncthingManager::acceptDeviceConnection(Device device)
 {
     // Send a PUT (or POST) to add the device.
-    QUrl url = api->m_baseUrl;
-    url.setPath(QString(CONFIGDEVICE));
+    QUrl url = api->endpointUrl(Endpoint::ConfigDevices);
     QJsonArray arr;
     QJsonObject obj;
     obj["deviceID"] = device.id;
@@ -428,19 +528,22 @@ void SyncthingManager::acceptDeviceConnection(Device device)
         obj["address"] = addr;
     }
     arr.append(obj);
-    QByteArray payload = QJsonDocument(arr).toJson();
+    QByteArray payload = QJsonDocument(arr).toJson(QJsonDocument::Compact);
     ApiRequest req;
     req.method = ApiRequest::PUT;
     req.url = url;
     req.payload = payload;
-    req.callback = [=](QNetworkReply *reply) {
+    req.onResult = [=, this](const ApiResult &result) {
         qDebug()<<"Im here  req.callback = [=](QNetworkReply *reply) {";
-        if (!reply->error()) {
+        if (result.ok()) {
             qDebug() << "Device" << device.ip << "accepted.";
             m_DeviceID = device.id;
+            m_acceptedDevices.insert(device.id);
+        } else {
+            api->forgetUnchanged(QLatin1String(PendingDevicesPoll));
         }
     };
-    api->enqueueRequest(req);
+    api->enqueueRequest(std::move(req));
 }
 
 
@@ -448,8 +551,7 @@ void SyncthingManager::acceptDeviceConnection(Device device)
 void SyncthingManager::acceptFolderSharing(Folder  folder)
 {
     // Send a PUT (or POST) to add the device.
-    QUrl url = api->m_baseUrl;
-    url.setPath(QString(CONFIGFOLDER));
+    QUrl url = api->endpointUrl(Endpoint::ConfigFolders);
 
     QJsonObject deviceO;
     deviceO["deviceID"]= m_allowedDeviceID;
@@ -469,42 +571,66 @@ void SyncthingManager::acceptFolderSharing(Folder  folder)
     QJsonArray rootArray;
     rootArray.append(jsonPayload);
     arr.append(obj);
-    QByteArray payload = QJsonDocument(rootArray).toJson();
+    QByteArray payload = QJsonDocument(rootArray).toJson(QJsonDocument::Compact);
     ApiRequest req;
     req.method = ApiRequest::PUT;
     req.url = url;
     req.payload = payload;
-    req.callback = [=](QNetworkReply *reply) {
-        if (!reply->error()) {
+    req.journalIntent = QString("accept folder %1").arg(folder.id);
+    req.onResult = [=, this](const ApiResult &result) {
+        if (result.ok()) {
             qDebug() << "Folder " << folder.id << "accepted.";
             m_FolderID = folder.id;
+            m_acceptedFolders.insert(folder.id);
+        } else {
+            api->forgetUnchanged(QLatin1String(PendingFoldersPoll));
         }
     };
-    api->enqueueRequest(req);
+    api->enqueueRequest(std::move(req));
 }
 
 
 void SyncthingManager::pollSyncthing() {
+    // Reply handling cost per poll cycle, for profiling only; enable with
+    // QT_LOGGING_RULES="syncthing.cost.debug=true".
+    if (SyncthingCostLog().isDebugEnabled()) {
+        const ApiHandler::ThreadStats stats = api->getThreadStats();
+        qCDebug(SyncthingCostLog) << "Reply handling this cycle:"
+                                  << stats.handlerUs - m_lastThreadStats.handlerUs << "us for"
+                                  << stats.replies - m_lastThreadStats.replies << "replies;"
+                                  << stats.callerUs - m_lastThreadStats.callerUs
+                                  << "us in callbacks bound to other threads";
+        m_lastThreadStats = stats;
+    }
     // Step 3: Poll pending device connections.
     if (IS_SERVER){
         if (!serverConnected){
-            QUrl pendingUrl = api->m_baseUrl;
-            pendingUrl.setPath(QString(PENDINGDEVICE));
+            QUrl pendingUrl = api->endpointUrl(Endpoint::PendingDevices);
             ApiRequest reqPending;
             reqPending.method = ApiRequest::GET;
             reqPending.url = pendingUrl;
-            reqPending.callback = [=](QNetworkReply *replyPending) {
-                //        if (!replyPending->error()) {
-                QJsonDocument pendDoc = QJsonDocument::fromJson(replyPending->readAll());
+            reqPending.coalesceKey = QLatin1String(PendingDevicesPoll);
+            reqPending.unchangedKey = reqPending.coalesceKey;
+            reqPending.onResult = [=, this](const ApiResult &pendingResult) {
+                // Nothing new since the last offer; failed accepts forget
+                // the last body, so they come back as changed.
+                if (pendingResult.superseded || pendingResult.notModified)
+                    return;
+                //        if (pendingResult.ok()) {
+                const QJsonDocument &pendDoc = pendingResult.document;
                 //            if (pendDoc.isObject()) {
 
                 QJsonObject pendObj = pendDoc.object();
+                if (pendingResult.ok())
+                    keepPending(m_acceptedDevices, pendObj);
                 auto list = pendObj.keys();
                 if(!list.isEmpty()){
                     auto last = list.last();
                     qDebug()<<last;
 
                     for (const QString &devId : pendObj.keys()) {
+                        if (m_acceptedDevices.contains(devId))
+                            continue;  // Accepted; the daemon has not caught up yet.
                         qDebug()<<"deviceConnectionRequested"<<devId;
                         Device d;//to do fill that
                         d.id = devId;
@@ -517,23 +643,30 @@ void SyncthingManager::pollSyncthing() {
                 //            }
                 //        }
             };
-            api->enqueueRequest(reqPending);
+            api->enqueueRequest(std::move(reqPending));
         }
     }
     // step4 : check folder update
 
     if(!IS_SERVER){
         // Step 3: Poll pending device connections.
-        QUrl pendingFUrl = api->m_baseUrl;
-        pendingFUrl.setPath(QString(PENDINGFOLDSERS));
+        QUrl pendingFUrl = api->endpointUrl(Endpoint::PendingFolders);
         ApiRequest reqFPending;
         reqFPending.method = ApiRequest::GET;
         reqFPending.url = pendingFUrl;
-        reqFPending.callback = [=](QNetworkReply *replyPending) {
-            QJsonDocument pendDoc = QJsonDocument::fromJson(replyPending->readAll());
+        reqFPending.coalesceKey = QLatin1String(PendingFoldersPoll);
+        reqFPending.unchangedKey = reqFPending.coalesceKey;
+        reqFPending.onResult = [=, this](const ApiResult &pendingResult) {
+            if (pendingResult.superseded || pendingResult.notModified)
+                return;  // Nothing new since the last offer.
+            const QJsonDocument &pendDoc = pendingResult.document;
             QJsonObject rootObj = pendDoc.object();
+            if (pendingResult.ok())
+                keepPending(m_acceptedFolders, rootObj);
             QList<Folder> folders;
             for (const QString &folderKey : rootObj.keys()) {
+                if (m_acceptedFolders.contains(folderKey))
+                    continue;  // Accepted; the daemon has not caught up yet.
                 QJsonObject folderObj = rootObj.value(folderKey).toObject();
                 // Parse the "offeredBy" object.
                 Folder folder;
@@ -585,7 +718,7 @@ void SyncthingManager::pollSyncthing() {
                 emit folderSharingRequested(folders.last());
 
         };
-        api->enqueueRequest(reqFPending);
+        api->enqueueRequest(std::move(reqFPending));
     }
     if (!IS_SERVER)
         checkUpdaterConnection();
@@ -599,91 +732,77 @@ void SyncthingManager::pollSyncthing() {
 
 void SyncthingManager::progressEvent()
 {
-    QString eventsUrl = QString("%1/rest/events?since=%2")
-            .arg(api->m_baseUrl.toString()).arg(lastEventId);
     ApiRequest req;
     req.method = ApiRequest::GET;
-    req.url = QUrl(eventsUrl);
-    req.callback = [this](QNetworkReply *reply) {
-        if (reply->error() != QNetworkReply::NoError) {
-            emit globalError(QString("Events poll error: %1").arg(reply->errorString()));
-            reply->deleteLater();
-            return;
-        }
-        QByteArray data = reply->readAll();
-        reply->deleteLater();
-        QJsonParseError parseError;
-        QJsonDocument doc = QJsonDocument::fromJson(data, &parseError);
-        if (parseError.error != QJsonParseError::NoError) {
-            emit globalError(QString("Events JSON parse error: %1").arg(parseError.errorString()));
-            return;
+    req.url = api->endpointUrl(Endpoint::Events);
+    req.url.setQuery(QLatin1String("since=") + QString::number(lastEventId));
+    req.coalesceKey = QStringLiteral("event-poll");
+    req.cancelToken = m_eventsToken;
+    // Events are handled one by one as they stream in.
+    req.onElement = [this](const QString &, const QJsonValue &evVal) {
+        QJsonObject ev = evVal.toObject();
+        quint64 id = static_cast<quint64>(ev.value("id").toDouble());
+        if (id > lastEventId){
+            lastEventId = id;
+            co->setLastEvent(id);
         }
-        if (!doc.isArray()) {
-            return;
-        }
-        QJsonArray events = doc.array();
-        bool newUpdate = !events.isEmpty();
-        for (const QJsonValue &evVal : events) {
-            QJsonObject ev = evVal.toObject();
-            quint64 id = static_cast<quint64>(ev.value("id").toDouble());
-            if (id > lastEventId){
-                lastEventId = id;
-                co->setLastEvent(id);
-            }
-            QString type = ev.value("type").toString();
-            QJsonObject dataObj = ev.value("data").toObject();
-            /*            if (type == "DownloadProgress") {
-                if (dataObj.isEmpty()) {
-                    lastFileProgress.clear();
-                } else {
-                    for (auto folderIt = dataObj.constBegin(); folderIt != dataObj.constEnd(); ++folderIt) {
-                        QString folderId = folderIt.key();
-                        QJsonObject filesObj = folderIt.value().toObject();
-                        for (auto fileIt = filesObj.constBegin(); fileIt != filesObj.constEnd(); ++fileIt) {
-                            QString fileName = fileIt.key();
-                            QJsonObject fileInfo = fileIt.value().toObject();
-                            int percent = 0;
-                            if (fileInfo.contains("bytesTotal") && fileInfo.contains("bytesDone")) {
-                                qint64 total = static_cast<qint64>(fileInfo.value("bytesTotal").toDouble());
-                                qint64 done  = static_cast<qint64>(fileInfo.value("bytesDone").toDouble());
-                                if (total > 0)
-                                    percent = static_cast<int>((done * 100) / total);
-                            }
-                            if (percent < 0) percent = 0;
-                            if (percent > 100) percent = 100;
-                            QString key = QString("local|%1|%2").arg(folderId).arg(fileName);
-                            int lastPerc = lastFileProgress.value(key, -1);
-                            if (percent != lastPerc) {
-                                emit fileTransferProgress("local", folderId, fileName, percent);
-                                lastFileProgress[key] = percent;
-                            }
+        QString type = ev.value("type").toString();
+        QJsonObject dataObj = ev.value("data").toObject();
+        /*            if (type == "DownloadProgress") {
+            if (dataObj.isEmpty()) {
+                lastFileProgress.clear();
+            } else {
+                for (auto folderIt = dataObj.constBegin(); folderIt != dataObj.constEnd(); ++folderIt) {
+                    QString folderId = folderIt.key();
+                    QJsonObject filesObj = folderIt.value().toObject();
+                    for (auto fileIt = filesObj.constBegin(); fileIt != filesObj.constEnd(); ++fileIt) {
+                        QString fileName = fileIt.key();
+                        QJsonObject fileInfo = fileIt.value().toObject();
+                        int percent = 0;
+                        if (fileInfo.contains("bytesTotal") && fileInfo.contains("bytesDone")) {
+                            qint64 total = static_cast<qint64>(fileInfo.value("bytesTotal").toDouble());
+                            qint64 done  = static_cast<qint64>(fileInfo.value("bytesDone").toDouble());
+                            if (total > 0)
+                                percent = static_cast<int>((done * 100) / total);
+                        }
+                        if (percent < 0) percent = 0;
+                        if (percent > 100) percent = 100;
+                        QString key = QString("local|%1|%2").arg(folderId).arg(fileName);
+                        int lastPerc = lastFileProgress.value(key, -1);
+                        if (percent != lastPerc) {
+                            emit fileTransferProgress("local", folderId, fileName, percent);
+                            lastFileProgress[key] = percent;
                         }
                     }
                 }
-            } else*/
-            if (!IS_SERVER){
-                if (type == "FolderCompletion") {
-                    QString folderId = dataObj.value("folder").toString();
-                    QString deviceId = dataObj.value("device").toString();
-                    int completion = dataObj.value("completion").toInt();
-                    if(completion == 100)
-                        emit updateDone();
-                    QString key = deviceId + "|" + folderId;
-                    int lastPerc = lastFolderProgress.value(key, -1);
-                    if (completion != lastPerc) {
-                        //                    emit folderSyncProgress(deviceId, folderId, completion);
-                        lastFolderProgress[key] = completion;
-                    }
+            }
+        } else*/
+        if (!IS_SERVER){
+            if (type == "FolderCompletion") {
+                QString folderId = dataObj.value("folder").toString();
+                QString deviceId = dataObj.value("device").toString();
+                int completion = dataObj.value("completion").toInt();
+                if(completion == 100)
+                    emit updateDone();
+                QString key = deviceId + "|" + folderId;
+                int lastPerc = lastFolderProgress.value(key, -1);
+                if (completion != lastPerc) {
+                    //                    emit folderSyncProgress(deviceId, folderId, completion);
+                    lastFolderProgress[key] = completion;
                 }
-            }/*else if (type == "RemoteIndexUpdated") {
-                pauseFolder(m_FolderID);
-                emit updateAvailable();
-            }*/else{
-                qDebug()<<"event type is "<<type;
             }
+        }/*else if (type == "RemoteIndexUpdated") {
+            pauseFolder(m_FolderID);
+            emit updateAvailable();
+        }*/else{
+            qDebug()<<"event type is "<<type;
         }
     };
-    api->enqueueRequest(req);
+    req.onResult = [this](const ApiResult &result) {
+        if (!result.ok() && !result.superseded)
+            emit globalError(QString("Events poll error: %1").arg(result.errorString));
+    };
+    api->enqueueRequest(std::move(req));
 }
 
 
@@ -719,38 +838,33 @@ void SyncthingManager::handleDeviceConnectionRequest(Device device)
 }
 void SyncthingManager::disconnectDevice(const QString &deviceId)
 {
-    QUrl url = api->m_baseUrl;
-    url.setPath(QString(DISCONNECTDEVICE ));
+    QUrl url = api->endpointUrl(Endpoint::ClusterDisconnect);
     QUrlQuery query;
     query.addQueryItem("device", deviceId);
     url.setQuery(query);
     ApiRequest req;
     req.method = ApiRequest::POST;
     req.url = url;
-    req.callback = [=](QNetworkReply *reply) {
-        if (!reply->error())
+    req.onResult = [=, this](const ApiResult &result) {
+        if (result.ok())
             qDebug() << "Device" << deviceId << "disconnected.";
         else
-            emit globalError(QString("Failed to disconnect device %1: %2").arg(deviceId, reply->errorString()));
-        reply->deleteLater();
+            emit globalError(QString("Failed to disconnect device %1: %2").arg(deviceId, result.errorString));
     };
-    api->enqueueRequest(req);
+    api->enqueueRequest(std::move(req));
 }
 void SyncthingManager::fetchDeviceId(const QString &deviceIp)
 {
-    QUrl devicesUrl = api->m_baseUrl;
-    devicesUrl.setPath(QString(CONFIGDEVICE));
+    QUrl devicesUrl = api->endpointUrl(Endpoint::ConfigDevices);
     ApiRequest req;
     req.method = ApiRequest::GET;
     req.url = devicesUrl;
-    req.callback = [this, deviceIp](QNetworkReply *reply) {
-        if (reply->error()) {
-            emit globalError(QString("fetchDeviceId error: %1").arg(reply->errorString()));
-            reply->deleteLater();
+    req.onResult = [this, deviceIp](const ApiResult &result) {
+        if (!result.ok()) {
+            emit globalError(QString("fetchDeviceId error: %1").arg(result.errorString));
             return;
         }
-        QJsonDocument doc = QJsonDocument::fromJson(reply->readAll());
-        reply->deleteLater();
+        const QJsonDocument &doc = result.document;
         QJsonArray arr = doc.array();
         QString foundId;
         for (const QJsonValue &val : arr) {
@@ -774,7 +888,7 @@ void SyncthingManager::fetchDeviceId(const QString &deviceIp)
         else
             emit globalError(QString("Device ID not found for IP: %1").arg(deviceIp));
     };
-    api->enqueueRequest(req);
+    api->enqueueRequest(std::move(req));
 }
 
 
@@ -787,26 +901,29 @@ void SyncthingManager::makeUpdate()
 
 void SyncthingManager::checkUpdaterConnection()
 {
-    QUrl clusterStatusUrl = api->m_baseUrl;
-    clusterStatusUrl.setPath(QString(CONNECTEDDEVICE));
+    QUrl clusterStatusUrl = api->endpointUrl(Endpoint::Connections);
     ApiRequest req;
     req.method = ApiRequest::GET;
     req.url = clusterStatusUrl;
-    req.callback = [this](QNetworkReply *reply) {
-        if (reply->error()) {
-            emit globalError(QString("Cluster status error: %1").arg(reply->errorString()));
-            reply->deleteLater();
+    req.unchangedKey = QStringLiteral("updater-connections");
+    req.onResult = [this](const ApiResult &result) {
+        if (!result.ok()) {
+            emit globalError(QString("Cluster status error: %1").arg(result.errorString));
+            return;
+        }
+        // Nothing new to report, but a lost peer still gets redialled.
+        if (result.notModified) {
+            if (!serverConnected)
+                connectToDeviceByIPv4(m_allowedDeviceIp);
             return;
         }
-        QJsonDocument doc = QJsonDocument::fromJson(reply->readAll());
-        reply->deleteLater();
-        if (!doc.isObject()) {
+        if (!result.document.isObject()) {
             emit globalError("Cluster status response is not a JSON object.");
             return;
         }
         bool remoteConnected = false;
         // Iterate over each device entry in the JSON.
-        QJsonObject root = doc.object();
+        QJsonObject root = result.document.object();
         QJsonObject connections = root.value("connections").toObject();
         for (auto it = connections.begin(); it != connections.end(); ++it) {
         auto key = it.key();
@@ -820,7 +937,7 @@ void SyncthingManager::checkUpdaterConnection()
             connectToDeviceByIPv4(m_allowedDeviceIp);
         emit otherDeviceConnected(remoteConnected);
     };
-    api->enqueueRequest(req);
+    api->enqueueRequest(std::move(req));
 }
 
 //only for server
@@ -846,20 +963,19 @@ void SyncthingManager::autoAcceptDeviceConnection(const Device& device)
     deviceObj["addresses"] = addrArr;
 
     // Step 3: Fetch current config
-    QUrl url = api->m_baseUrl;
-    url.setPath(QString(CONFIG));
+    QUrl url = api->endpointUrl(Endpoint::SystemConfig);
 
     ApiRequest getConfig;
     getConfig.method = ApiRequest::GET;
     getConfig.url = url;
-    getConfig.callback = [this, deviceObj, url](QNetworkReply *reply) {
-        if (reply->error()) {
-            emit globalError("Failed to fetch config: " + reply->errorString());
+    getConfig.onResult = [this, deviceObj, url](const ApiResult &result) {
+        if (!result.ok()) {
+            api->forgetUnchanged(QLatin1String(PendingDevicesPoll));
+            emit globalError("Failed to fetch config: " + result.errorString);
             return;
         }
 
-        QJsonDocument doc = QJsonDocument::fromJson(reply->readAll());
-        QJsonObject root = doc.object();
+        QJsonObject root = result.document.object();
 
         QJsonArray devices = root["devices"].toArray();
 
@@ -867,6 +983,7 @@ void SyncthingManager::autoAcceptDeviceConnection(const Device& device)
         for (const auto& val : devices) {
             if (val.toObject().value("deviceID") == deviceObj["deviceID"]) {
                 qDebug() << "[SyncthingManager] Device already trusted:" << deviceObj["deviceID"].toString();
+                m_acceptedDevices.insert(deviceObj["deviceID"].toString());
                 return;
             }
         }
@@ -880,38 +997,38 @@ void SyncthingManager::autoAcceptDeviceConnection(const Device& device)
         setConfig.method = ApiRequest::POST;
         setConfig.url = url;
         setConfig.payload = payload;
-        setConfig.callback = [this, deviceObj](QNetworkReply *setReply) {
-            if (!setReply->error()) {
+        setConfig.onResult = [this, deviceObj](const ApiResult &setResult) {
+            if (setResult.ok()) {
                 qDebug() << "[SyncthingManager] Auto-accepted device:" << deviceObj["deviceID"].toString();
+                m_acceptedDevices.insert(deviceObj["deviceID"].toString());
             } else {
-                emit globalError("Failed to apply config: " + setReply->errorString());
+                api->forgetUnchanged(QLatin1String(PendingDevicesPoll));
+                emit globalError("Failed to apply config: " + setResult.errorString);
             }
         };
 
-        api->enqueueRequest(setConfig);
+        api->enqueueRequest(std::move(setConfig));
     };
 
-    api->enqueueRequest(getConfig);
+    api->enqueueRequest(std::move(getConfig));
 }
 
 
 //for evry device
 void SyncthingManager::configureLocalOnlyNode(const QString& deviceName, const QString& bindIp)
 {
-    QUrl url = api->m_baseUrl;
-    url.setPath(QString(CONFIG));
+    QUrl url = api->endpointUrl(Endpoint::SystemConfig);
 
     ApiRequest getConfig;
     getConfig.method = ApiRequest::GET;
     getConfig.url = url;
-    getConfig.callback = [this, url, deviceName, bindIp](QNetworkReply* reply) {
-        if (reply->error() != QNetworkReply::NoError) {
-            emit globalError("Failed to get system config: " + reply->errorString());
+    getConfig.onResult = [this, url, deviceName, bindIp](const ApiResult &result) {
+        if (!result.ok()) {
+            emit globalError("Failed to get system config: " + result.errorString);
             return;
         }
 
-        QJsonDocument doc = QJsonDocument::fromJson(reply->readAll());
-        QJsonObject config = doc.object();
+        QJsonObject config = result.document.object();
 
         // Step 1: Disable global discovery, NAT traversal, relaying
         QJsonObject options = config["options"].toObject();
@@ -936,31 +1053,29 @@ void SyncthingManager::configureLocalOnlyNode(const QString& deviceName, const Q
         setConfig.method = ApiRequest::POST;
         setConfig.url = url;
         setConfig.payload = updatedConfig;
-        setConfig.callback = [this](QNetworkReply* setReply) {
-            if (setReply->error() == QNetworkReply::NoError) {
+        setConfig.onResult = [this](const ApiResult &setResult) {
+            if (setResult.ok()) {
                 qDebug() << "[SyncthingManager] Node configured for local-only sync.";
             } else {
-                emit globalError("Failed to set config: " + setReply->errorString());
+                emit globalError("Failed to set config: " + setResult.errorString);
             }
         };
 
-        api->enqueueRequest(setConfig);
+        api->enqueueRequest(std::move(setConfig));
     };
 
-    api->enqueueRequest(getConfig);
+    api->enqueueRequest(std::move(getConfig));
 }
 
 void SyncthingManager::getMyDeviceId()
 {
-    QUrl url = api->m_baseUrl;
-    url.setPath(QString(MYSTATUS ));
+    QUrl url = api->endpointUrl(Endpoint::SystemStatus);
     ApiRequest req;
     req.method = ApiRequest::POST;
     req.url = url;
-    req.callback = [=](QNetworkReply *reply) {
-        if (!reply->error()){
-            auto response = reply->readAll();
-            auto doc = QJsonDocument::fromJson(response);
+    req.onResult = [=, this](const ApiResult &result) {
+        if (result.ok()){
+            const QJsonDocument &doc = result.document;
             if (!doc.isNull()&&doc.isObject()){
                 auto obj = doc.object();
                 if(obj.contains("myID"))
@@ -968,206 +1083,167 @@ void SyncthingManager::getMyDeviceId()
                 if( !myDeviceID.isEmpty() )
                     qDebug()<<"my Devicde ID is ......";
             }
-        }else
-            reply->deleteLater();
+        }
     };
-    api->enqueueRequest(req);
+    api->enqueueRequest(std::move(req));
 }
 
 
 
 void SyncthingManager::renameLocalDevice(const QString &newName)
 {
-    // Step 1: Get local device ID from /rest/system/status
-    QUrl statusUrl = api->m_baseUrl;
-    statusUrl.setPath(QString(MYSTATUS));
-
-    ApiRequest statusReq;
-    statusReq.method = ApiRequest::GET;
-    statusReq.url    = statusUrl;
-    statusReq.callback = [this, newName](QNetworkReply *statusReply) {
-        if (statusReply->error() != QNetworkReply::NoError) {
-            emit globalError("Failed to get system status: " + statusReply->errorString());
-            statusReply->deleteLater();
-            return;
-        }
-        // Parse out "myID"
-        QByteArray statusData = statusReply->readAll();
-        statusReply->deleteLater();
-        QJsonDocument statusDoc = QJsonDocument::fromJson(statusData);
-        if (!statusDoc.isObject()) {
-            emit globalError("Unexpected status format");
-            return;
-        }
-        QString localId = statusDoc.object().value("myID").toString();
-        if (localId.isEmpty()) {
-            emit globalError("Local device ID not found in status");
-            return;
+    renameLocalDeviceFlow(newName);
+}
+
+ApiTask SyncthingManager::renameLocalDeviceFlow(QString newName)
+{
+    // Step 1: status (for the local device ID) and the full config are
+    // independent, so fetch both at once.
+    const QUrl configUrl = api->endpointUrl(Endpoint::SystemConfig);
+    const QVector<ApiResult> fetched = co_await whenAll(
+                api->get(api->endpointUrl(Endpoint::SystemStatus)),
+                api->get(configUrl));
+    const ApiResult &statusResult = fetched.at(0);
+    const ApiResult &cfgResult = fetched.at(1);
+
+    if (!statusResult.ok()) {
+        emit globalError("Failed to get system status: " + statusResult.errorString);
+        co_return;
+    }
+    // Parse out "myID"
+    if (!statusResult.document.isObject()) {
+        emit globalError("Unexpected status format");
+        co_return;
+    }
+    const QString localId = statusResult.document.object().value("myID").toString();
+    if (localId.isEmpty()) {
+        emit globalError("Local device ID not found in status");
+        co_return;
+    }
+    if (!cfgResult.ok()) {
+        emit globalError("Failed to fetch config: " + cfgResult.errorString);
+        co_return;
+    }
+    if (!cfgResult.document.isObject()) {
+        emit globalError("Unexpected config format");
+        co_return;
+    }
+    QJsonObject cfgObj = cfgResult.document.object();
+
+    // Step 2: Update the "name" field for the local device
+    QJsonArray devices = cfgObj.value("devices").toArray();
+    bool found = false;
+    for (int i = 0; i < devices.size(); ++i) {
+        QJsonObject dev = devices.at(i).toObject();
+        if (dev.value("deviceID").toString() == localId) {
+            dev["name"] = newName;
+            devices.replace(i, dev);
+            found = true;
+            break;
         }
+    }
+    if (!found) {
+        emit globalError("Local device entry not found in config");
+        co_return;
+    }
+    cfgObj["devices"] = devices;
 
-        // Step 2: Get full config from /rest/system/config
-        QUrl configUrl = api->m_baseUrl;
-        configUrl.setPath("/rest/system/config");
-        ApiRequest getCfgReq;
-        getCfgReq.method = ApiRequest::GET;
-        getCfgReq.url    = configUrl;
-        getCfgReq.callback = [this, newName, localId, configUrl](QNetworkReply *cfgReply) {
-            if (cfgReply->error() != QNetworkReply::NoError) {
-                emit globalError("Failed to fetch config: " + cfgReply->errorString());
-                cfgReply->deleteLater();
-                return;
-            }
-            // Parse config JSON
-            QByteArray cfgData = cfgReply->readAll();
-            cfgReply->deleteLater();
-            QJsonDocument cfgDoc = QJsonDocument::fromJson(cfgData);
-            if (!cfgDoc.isObject()) {
-                emit globalError("Unexpected config format");
-                return;
-            }
-            QJsonObject cfgObj = cfgDoc.object();
-
-            // Step 3: Update the "name" field for the local device
-            QJsonArray devices = cfgObj.value("devices").toArray();
-            bool found = false;
-            for (int i = 0; i < devices.size(); ++i) {
-                QJsonObject dev = devices.at(i).toObject();
-                if (dev.value("deviceID").toString() == localId) {
-                    dev["name"] = newName;
-                    devices.replace(i, dev);
-                    found = true;
-                    break;
-                }
-            }
-            if (!found) {
-                emit globalError("Local device entry not found in config");
-                return;
-            }
-            cfgObj["devices"] = devices;
-
-            // Step 4: POST the modified config back
-            QByteArray payload = QJsonDocument(cfgObj).toJson(QJsonDocument::Compact);
-            ApiRequest setCfgReq;
-            setCfgReq.method  = ApiRequest::POST;
-            setCfgReq.url     = configUrl;
-            setCfgReq.payload = payload;
-            setCfgReq.callback = [this](QNetworkReply *setReply) {
-                if (setReply->error() != QNetworkReply::NoError) {
-                    emit globalError("Failed to apply config: " + setReply->errorString());
-                } else {
-                    qDebug() << "[SyncthingManager] Renamed device successfully.";
-                    emit requestProcessed("Local device renamed to deviceID");
-                }
-                setReply->deleteLater();
-            };
-            api->enqueueRequest(setCfgReq);
-        };
-        api->enqueueRequest(getCfgReq);
-    };
-    api->enqueueRequest(statusReq);
+    // Step 3: POST the modified config back
+    const ApiResult setResult = co_await api->post(
+                configUrl, QJsonDocument(cfgObj).toJson(QJsonDocument::Compact));
+    if (!setResult.ok()) {
+        emit globalError("Failed to apply config: " + setResult.errorString);
+    } else {
+        qDebug() << "[SyncthingManager] Renamed device successfully.";
+        emit requestProcessed("Local device renamed to deviceID");
+    }
 }
 
 
 
 
 void SyncthingManager::connectToDeviceByIPv4(const QString &ipPort)
+{
+    connectToDeviceFlow(ipPort);
+}
+
+ApiTask SyncthingManager::connectToDeviceFlow(QString ipPort)
 {
     // Step 1: GET /rest/system/discovery
-    QUrl discUrl = api->m_baseUrl;
-    discUrl.setPath(QString(DISCOVERY));
-
-    ApiRequest discReq;
-    discReq.method = ApiRequest::GET;
-    discReq.url    = discUrl;
-    discReq.callback = [this, ipPort](QNetworkReply *discReply) {
-        if (discReply->error() != QNetworkReply::NoError) {
-            emit globalError(
-                        QString("Failed to fetch discovery: %1")
-                        .arg(discReply->errorString()));
-            discReply->deleteLater();
-            return;
-        }
+    const ApiResult discResult = co_await api->get(api->endpointUrl(Endpoint::Discovery));
+    if (!discResult.ok()) {
+        emit globalError(
+                    QString("Failed to fetch discovery: %1")
+                    .arg(discResult.errorString));
+        co_return;
+    }
 
-        // Parse JSON: { deviceID: { "addresses": [ ... ] }, ... }
-        QJsonDocument doc = QJsonDocument::fromJson(discReply->readAll());
-        discReply->deleteLater();
-        if (!doc.isObject()) {
-            emit globalError("Discovery returned unexpected format");
-            return;
-        }
-        QJsonObject root = doc.object();
-
-        // Step 2: find deviceID matching ipPort
-        QString foundId, foundAddr;
-        for (auto it = root.begin(); it != root.end(); ++it) {
-            const QString deviceId = it.key();
-            QJsonObject entry = it.value().toObject();
-            QJsonArray addrs = entry.value("addresses").toArray();
-            for (const QJsonValue &v : addrs) {
-                QString raw = v.toString();
-                // strip any scheme
-                QString candidate = raw;
-                if (candidate.startsWith("tcp://"))
-                    candidate = candidate.mid(6);
-                else if (candidate.startsWith("tcp4://"))
-                    candidate = candidate.mid(7);
-
-                if (candidate == ipPort) {
-                    // preserve original scheme if present
-                    if (raw.startsWith("tcp4://"))
-                        foundAddr = raw;
-                    else
-                        foundAddr = QString("tcp://%1").arg(candidate);
-                    foundId = deviceId;
-                    break;
-                }
+    // Parsed JSON: { deviceID: { "addresses": [ ... ] }, ... }
+    if (!discResult.document.isObject()) {
+        emit globalError("Discovery returned unexpected format");
+        co_return;
+    }
+    const QJsonObject root = discResult.document.object();
+
+    // Step 2: find deviceID matching ipPort
+    QString foundId, foundAddr;
+    for (auto it = root.begin(); it != root.end(); ++it) {
+        const QString deviceId = it.key();
+        QJsonObject entry = it.value().toObject();
+        QJsonArray addrs = entry.value("addresses").toArray();
+        for (const QJsonValue &v : addrs) {
+            QString raw = v.toString();
+            // strip any scheme
+            QString candidate = raw;
+            if (candidate.startsWith("tcp://"))
+                candidate = candidate.mid(6);
+            else if (candidate.startsWith("tcp4://"))
+                candidate = candidate.mid(7);
+
+            if (candidate == ipPort) {
+                // preserve original scheme if present
+                if (raw.startsWith("tcp4://"))
+                    foundAddr = raw;
+                else
+                    foundAddr = QString("tcp://%1").arg(candidate);
+                foundId = deviceId;
+                break;
             }
-            if (!foundId.isEmpty()) break;
-        }
-
-        if (foundId.isEmpty()) {
-            emit globalError(
-                        QString("No device found advertising %1").arg(ipPort));
-            return;
         }
+        if (!foundId.isEmpty()) break;
+    }
 
-        // Step 3: PUT /rest/config/devices with single-element array
-        QUrl cfgUrl = api->m_baseUrl;
-        cfgUrl.setPath(QString(REQUESTCONNECTION));
-
-        QJsonObject devObj;
-        devObj["deviceID"]  = foundId;
-        // include address override for this peer
-        devObj["addresses"] = QJsonArray{ foundAddr };
-        // optional: preserve known name
-        QString name = deviceInfoMap.value(foundId).devName;
-        if (!name.isEmpty())
-            devObj["name"] = name;
-
-        QJsonArray payloadArr;
-        payloadArr.append(devObj);
-
-        ApiRequest putReq;
-        putReq.method  = ApiRequest::PUT;
-        putReq.url     = cfgUrl;
-        putReq.payload = QJsonDocument(payloadArr).toJson(QJsonDocument::Compact);
-        putReq.callback = [this, foundId, foundAddr](QNetworkReply *putReply) {
-            if (putReply->error() == QNetworkReply::NoError) {
-                qDebug() << "[SyncthingManager] Sent connection request to"
-                         << foundId << "@" << foundAddr;
-                emit deviceAdded(foundId);
-            } else {
-                emit globalError(
-                            QString("Connect-to-device failed: %1")
-                            .arg(putReply->errorString()));
-            }
-            putReply->deleteLater();
-        };
-
-        api->enqueueRequest(putReq);
-    };
+    if (foundId.isEmpty()) {
+        emit globalError(
+                    QString("No device found advertising %1").arg(ipPort));
+        co_return;
+    }
 
-    api->enqueueRequest(discReq);
+    // Step 3: PUT /rest/config/devices with single-element array
+    QJsonObject devObj;
+    devObj["deviceID"]  = foundId;
+    // include address override for this peer
+    devObj["addresses"] = QJsonArray{ foundAddr };
+    // optional: preserve known name
+    QString name = deviceInfoMap.value(foundId).devName;
+    if (!name.isEmpty())
+        devObj["name"] = name;
+
+    QJsonArray payloadArr;
+    payloadArr.append(devObj);
+
+    const ApiResult putResult = co_await api->put(
+                api->endpointUrl(Endpoint::ConfigDevices),
+                QJsonDocument(payloadArr).toJson(QJsonDocument::Compact));
+    if (putResult.ok()) {
+        qDebug() << "[SyncthingManager] Sent connection request to"
+                 << foundId << "@" << foundAddr;
+        emit deviceAdded(foundId);
+    } else {
+        emit globalError(
+                    QString("Connect-to-device failed: %1")
+                    .arg(putResult.errorString));
+    }
 }
 
 
@@ -1183,33 +1259,26 @@ void SyncthingManager::shareLocalFolder(const QString &folderPath)
     QString label = QFileInfo(folderPath).fileName();
 
     // 1) Fetch full config
-    QUrl cfgUrl = api->m_baseUrl;
-    cfgUrl.setPath(QString(CONFIG));
+    QUrl cfgUrl = api->endpointUrl(Endpoint::SystemConfig);
 
     ApiRequest getReq;
     getReq.method = ApiRequest::GET;
     getReq.url    = cfgUrl;
-    getReq.callback = [this, folderId, folderPath, label, cfgUrl](QNetworkReply *getReply) {
-        if (getReply->error() != QNetworkReply::NoError) {
+    getReq.onResult = [this, folderId, folderPath, label, cfgUrl](const ApiResult &getResult) {
+        if (!getResult.ok()) {
             emit globalError(
                         QString("Failed to fetch config: %1")
-                        .arg(getReply->errorString()));
-            getReply->deleteLater();
+                        .arg(getResult.errorString));
             return;
         }
 
-        // Parse JSON
-        QByteArray data = getReply->readAll();
-        getReply->deleteLater();
-        QJsonParseError parseErr;
-        QJsonDocument doc = QJsonDocument::fromJson(data, &parseErr);
-        if (parseErr.error != QJsonParseError::NoError || !doc.isObject()) {
+        if (getResult.parseError.error != QJsonParseError::NoError || !getResult.document.isObject()) {
             emit globalError(
                         QString("Invalid config JSON: %1")
-                        .arg(parseErr.errorString()));
+                        .arg(getResult.parseError.errorString()));
             return;
         }
-        QJsonObject cfg = doc.object();
+        QJsonObject cfg = getResult.document.object();
 
         // Ensure "folders" exists
         if (!cfg.contains("folders") || !cfg["folders"].isArray()) {
@@ -1234,8 +1303,8 @@ void SyncthingManager::shareLocalFolder(const QString &folderPath)
         postReq.method  = ApiRequest::POST;
         postReq.url     = cfgUrl;
         postReq.payload = payload;
-        postReq.callback = [this, folderId](QNetworkReply *postReply) {
-            if (postReply->error() == QNetworkReply::NoError) {
+        postReq.onResult = [this, folderId](const ApiResult &postResult) {
+            if (postResult.ok()) {
                 qDebug() << "[SyncthingManager] Shared folder added:" << folderId;
                 m_FolderID = folderId;
                 m_SharedFolderId = m_FolderID;
@@ -1244,44 +1313,39 @@ void SyncthingManager::shareLocalFolder(const QString &folderPath)
             } else {
                 emit globalError(
                             QString("Failed to add folder \"%1\": %2")
-                            .arg(folderId, postReply->errorString()));
+                            .arg(folderId, postResult.errorString));
             }
-            postReply->deleteLater();
         };
 
-        api->enqueueRequest(postReq);
+        api->enqueueRequest(std::move(postReq));
     };
 
-    api->enqueueRequest(getReq);
+    api->enqueueRequest(std::move(getReq));
 }
 
 
 void SyncthingManager::shareLocalFolderIfNeeded(const QString &folderPath)
 {
     // 1) Fetch current config
-    QUrl cfgUrl = api->m_baseUrl;
-    cfgUrl.setPath(QString(CONFIG));
+    QUrl cfgUrl = api->endpointUrl(Endpoint::SystemConfig);
 
     ApiRequest cfgReq;
     cfgReq.method = ApiRequest::GET;
     cfgReq.url    = cfgUrl;
-    cfgReq.callback = [this, folderPath](QNetworkReply *reply) {
-        if (reply->error() != QNetworkReply::NoError) {
+    cfgReq.onResult = [this, folderPath](const ApiResult &result) {
+        if (!result.ok()) {
             emit globalError(
-                        QString("Failed to fetch config: %1").arg(reply->errorString())
+                        QString("Failed to fetch config: %1").arg(result.errorString)
                         );
-            reply->deleteLater();
             return;
         }
 
-        QJsonDocument doc = QJsonDocument::fromJson(reply->readAll());
-        reply->deleteLater();
-        if (!doc.isObject()) {
+        if (!result.document.isObject()) {
             emit globalError("Invalid config JSON");
             return;
         }
 
-        QJsonObject root = doc.object();
+        QJsonObject root = result.document.object();
         QJsonArray folders = root.value("folders").toArray();
 
         // 2) Check if any folder.path matches
@@ -1301,125 +1365,105 @@ void SyncthingManager::shareLocalFolderIfNeeded(const QString &folderPath)
         shareLocalFolder(folderPath);
     };
 
-    api->enqueueRequest(cfgReq);
+    api->enqueueRequest(std::move(cfgReq));
 }
 
 void SyncthingManager::shareFolderWithConnectedDevices(const QString &folderId)
 {
     //to remember share folder
     m_SharedFolderId = folderId;
+    shareFolderFlow(folderId);
+}
 
-    // Step 1: Get list of currently connected devices
-    QUrl connUrl = api->m_baseUrl;
-    connUrl.setPath(QString(CONNECTEDDEVICE));
-    ApiRequest connReq;
-    connReq.method = ApiRequest::GET;
-    connReq.url    = connUrl;
-    connReq.callback = [this, folderId](QNetworkReply *connReply) {
-        if (connReply->error() != QNetworkReply::NoError) {
-            emit globalError(
-                        QString("Failed to fetch connections: %1")
-                        .arg(connReply->errorString()));
-            connReply->deleteLater();
-            return;
-        }
-        // Parse connections JSON
-        QJsonDocument connDoc = QJsonDocument::fromJson(connReply->readAll());
-        connReply->deleteLater();
-        if (!connDoc.isObject()) {
-            emit globalError("Unexpected /rest/system/connections format");
-            return;
-        }
-        QJsonObject allConns = connDoc.object().value("connections").toObject();
-        QStringList connectedIds;
-        for (auto it = allConns.begin(); it != allConns.end(); ++it) {
-            QJsonObject c = it.value().toObject();
-            if (c.value("connected").toBool()) {
-                connectedIds << it.key();
-            }
-        }
-        if (connectedIds.isEmpty()) {
-            emit globalError("No devices currently connected");
-            return;
+ApiTask SyncthingManager::shareFolderFlow(QString folderId)
+{
+    // Step 1: connected devices and the full config, fetched concurrently
+    const QUrl cfgUrl = api->endpointUrl(Endpoint::SystemConfig);
+    const QVector<ApiResult> fetched = co_await whenAll(
+                api->get(api->endpointUrl(Endpoint::Connections)),
+                api->get(cfgUrl));
+    const ApiResult &connResult = fetched.at(0);
+    const ApiResult &cfgResult = fetched.at(1);
+
+    if (!connResult.ok()) {
+        emit globalError(
+                    QString("Failed to fetch connections: %1")
+                    .arg(connResult.errorString));
+        co_return;
+    }
+    if (!connResult.document.isObject()) {
+        emit globalError("Unexpected /rest/system/connections format");
+        co_return;
+    }
+    const QJsonObject allConns = connResult.document.object().value("connections").toObject();
+    QStringList connectedIds;
+    for (auto it = allConns.begin(); it != allConns.end(); ++it) {
+        QJsonObject c = it.value().toObject();
+        if (c.value("connected").toBool()) {
+            connectedIds << it.key();
         }
+    }
+    if (connectedIds.isEmpty()) {
+        emit globalError("No devices currently connected");
+        co_return;
+    }
 
-        // Step 2: Fetch full config
-        QUrl cfgUrl = api->m_baseUrl;
-        cfgUrl.setPath(QString(CONFIG));
-        ApiRequest cfgReq;
-        cfgReq.method = ApiRequest::GET;
-        cfgReq.url    = cfgUrl;
-        cfgReq.callback = [this, folderId, connectedIds, cfgUrl](QNetworkReply *cfgReply) {
-            if (cfgReply->error() != QNetworkReply::NoError) {
-                emit globalError(
-                            QString("Failed to fetch config: %1")
-                            .arg(cfgReply->errorString()));
-                cfgReply->deleteLater();
-                return;
-            }
-            QJsonParseError pe;
-            QJsonDocument cfgDoc = QJsonDocument::fromJson(cfgReply->readAll(), &pe);
-            cfgReply->deleteLater();
-            if (pe.error != QJsonParseError::NoError || !cfgDoc.isObject()) {
-                emit globalError(
-                            QString("Invalid config JSON: %1")
-                            .arg(pe.errorString()));
-                return;
-            }
-            QJsonObject cfg = cfgDoc.object();
+    if (!cfgResult.ok()) {
+        emit globalError(
+                    QString("Failed to fetch config: %1")
+                    .arg(cfgResult.errorString));
+        co_return;
+    }
+    if (cfgResult.parseError.error != QJsonParseError::NoError || !cfgResult.document.isObject()) {
+        emit globalError(
+                    QString("Invalid config JSON: %1")
+                    .arg(cfgResult.parseError.errorString()));
+        co_return;
+    }
+    QJsonObject cfg = cfgResult.document.object();
 
-            // Locate and update the folder's devices array
-            if (!cfg.contains("folders") || !cfg["folders"].isArray()) {
-                emit globalError("Config missing \"folders\" array");
-                return;
-            }
-            QJsonArray folders = cfg["folders"].toArray();
-            bool found = false;
-            for (int i = 0; i < folders.size(); ++i) {
-                QJsonObject fo = folders.at(i).toObject();
-                if (fo.value("id").toString() == folderId) {
-                    // Build devices array
-                    QJsonArray devArr;
-                    for (const QString &devId : connectedIds) {
-                        QJsonObject d;
-                        d["deviceID"] = devId;
-                        devArr.append(d);
-                    }
-                    fo["devices"] = devArr;
-                    folders.replace(i, fo);
-                    found = true;
-                    break;
-                }
-            }
-            if (!found) {
-                emit globalError(
-                            QString("Folder \"%1\" not found in config").arg(folderId));
-                return;
+    // Step 2: Locate and update the folder's devices array
+    if (!cfg.contains("folders") || !cfg["folders"].isArray()) {
+        emit globalError("Config missing \"folders\" array");
+        co_return;
+    }
+    QJsonArray folders = cfg["folders"].toArray();
+    bool found = false;
+    for (int i = 0; i < folders.size(); ++i) {
+        QJsonObject fo = folders.at(i).toObject();
+        if (fo.value("id").toString() == folderId) {
+            // Build devices array
+            QJsonArray devArr;
+            for (const QString &devId : connectedIds) {
+                QJsonObject d;
+                d["deviceID"] = devId;
+                devArr.append(d);
             }
-            cfg["folders"] = folders;
-
-            // Step 3: POST updated config
-            ApiRequest postReq;
-            postReq.method  = ApiRequest::POST;
-            postReq.url     = cfgUrl;
-            postReq.payload = QJsonDocument(cfg).toJson(QJsonDocument::Compact);
-            postReq.callback = [this, folderId](QNetworkReply *postReply) {
-                if (postReply->error() == QNetworkReply::NoError) {
-                    qDebug() << "[SyncthingManager] Shared folder"
-                             << folderId << "to all connected devices.";
-                    emit folderRescanned(folderId);
-                } else {
-                    emit globalError(
-                                QString("Failed to share folder \"%1\": %2")
-                                .arg(folderId, postReply->errorString()));
-                }
-                postReply->deleteLater();
-            };
-            api->enqueueRequest(postReq);
-        };
-        api->enqueueRequest(cfgReq);
-    };
-    api->enqueueRequest(connReq);
+            fo["devices"] = devArr;
+            folders.replace(i, fo);
+            found = true;
+            break;
+        }
+    }
+    if (!found) {
+        emit globalError(
+                    QString("Folder \"%1\" not found in config").arg(folderId));
+        co_return;
+    }
+    cfg["folders"] = folders;
+
+    // Step 3: POST updated config
+    const ApiResult postResult = co_await api->post(
+                cfgUrl, QJsonDocument(cfg).toJson(QJsonDocument::Compact));
+    if (postResult.ok()) {
+        qDebug() << "[SyncthingManager] Shared folder"
+                 << folderId << "to all connected devices.";
+        emit folderRescanned(folderId);
+    } else {
+        emit globalError(
+                    QString("Failed to share folder \"%1\": %2")
+                    .arg(folderId, postResult.errorString));
+    }
 }
 
 
@@ -1428,28 +1472,24 @@ void SyncthingManager::shareFolderWithConnectedDevices(const QString &folderId)
 void SyncthingManager::addDeviceToSharedFolder(const QString &deviceId)
 {
     // 1) GET the full config
-    QUrl cfgUrl = api->m_baseUrl;
-    cfgUrl.setPath(QString(CONFIG));  // "/rest/system/config"
+    QUrl cfgUrl = api->endpointUrl(Endpoint::SystemConfig);
     ApiRequest getReq;
     getReq.method = ApiRequest::GET;
     getReq.url    = cfgUrl;
-    getReq.callback = [this, deviceId, cfgUrl](QNetworkReply *reply) {
-        if (reply->error() != QNetworkReply::NoError) {
+    getReq.onResult = [this, deviceId, cfgUrl](const ApiResult &result) {
+        if (!result.ok()) {
             emit globalError(
                         QString("addDeviceToSharedFolder: config fetch failed: %1")
-                        .arg(reply->errorString()));
-            reply->deleteLater();
+                        .arg(result.errorString));
             return;
         }
 
-        // 2) Parse and locate our folder
-        QJsonDocument doc = QJsonDocument::fromJson(reply->readAll());
-        reply->deleteLater();
-        if (!doc.isObject()) {
+        // 2) Locate our folder in the shared, already-parsed config
+        if (!result.document.isObject()) {
             emit globalError("addDeviceToSharedFolder: invalid config JSON");
             return;
         }
-        QJsonObject cfg     = doc.object();
+        QJsonObject cfg     = result.document.object();
         QJsonArray  folders = cfg.value("folders").toArray();
         bool        found   = false;
 
@@ -1492,21 +1532,20 @@ void SyncthingManager::addDeviceToSharedFolder(const QString &deviceId)
         postReq.method  = ApiRequest::POST;
         postReq.url     = cfgUrl;
         postReq.payload = payload;
-        postReq.callback = [this, deviceId](QNetworkReply *postReply) {
-            if (postReply->error() != QNetworkReply::NoError) {
+        postReq.onResult = [this, deviceId](const ApiResult &postResult) {
+            if (!postResult.ok()) {
                 emit globalError(
                             QString("addDeviceToSharedFolder: failed to share to %1: %2")
-                            .arg(deviceId, postReply->errorString()));
+                            .arg(deviceId, postResult.errorString));
             } else {
                 qDebug() << "[SyncthingManager] Shared folder"
                          << m_SharedFolderId
                          << "to new device" << deviceId;
             }
-            postReply->deleteLater();
         };
-        api->enqueueRequest(postReq);
+        api->enqueueRequest(std::move(postReq));
     };
-    api->enqueueRequest(getReq);
+    api->enqueueRequest(std::move(getReq));
 }
 
 
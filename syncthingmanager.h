@@ -9,10 +9,13 @@
 #include <QJsonArray>
 #include <QVector>
 #include <QQueue>
+#include <QSet>
 #include <QTimer>
 #include <QList>
 #include <QMap>
 
+class ApiTask;
+
 #define WORKDIR "/work/bin/"
 #define CONFIGDIR "/work/config/"
 #define LOGDIR "/work/log/"
@@ -136,6 +139,13 @@ private slots:
 
     void healthError();
 private:
+    // Coroutine bodies of the multi-step operations above.
+    ApiTask renameLocalDeviceFlow(QString newName);
+    ApiTask connectToDeviceFlow(QString ipPort);
+    ApiTask shareFolderFlow(QString folderId);
+    void writeSystemLog(QJsonObject combined);
+    // Ends the health check in progress with its verdict.
+    void reportHealth(bool isHealthy, const QString &reason);
 
     QString myDeviceID;
 
@@ -152,8 +162,16 @@ private:
     QTimer m_eventsTimer;
     QTimer m_pingTimer;
     quint64 lastEventId;  // ID of last processed event for incremental polling
+    ApiCancelToken m_healthToken;  // Withdraws the health check still in progress.
+    bool m_healthCheckPending = false;  // Started, but not yet reported.
+    ApiCancelToken m_eventsToken;  // Withdraws event polls once polling stops.
+    ApiHandler::ThreadStats m_lastThreadStats;  // Reply handling cost at the last poll.
     QString m_allowedDeviceIp;  // Allowed device IP; others are denied.
     QString m_allowedDeviceID;
+    // Pending entries accepted successfully; an unchanged poll reply does
+    // not offer these again, but still offers whatever failed to go through.
+    QSet<QString> m_acceptedDevices;
+    QSet<QString> m_acceptedFolders;
     // Last reported percentages to filter out redundant signals
     QHash<QString, int> lastFileProgress;    // Key: "device|folder|file"
     QHash<QString, int> lastFolderProgress;  // Key: "device|folder"
@@ -0,0 +1,243 @@
+#ifndef TIMERWHEEL_H
+#define TIMERWHEEL_H
+
+#include <QtGlobal>
+#include <QtAlgorithms>
+#include <QVector>
+#include <limits>
+#include <utility>
+
+// Hierarchical timing wheel after Varghese and Lauck: four levels of 64
+// slots, each level 64 times coarser than the one below, so 4 ms ticks
+// cover 18 hours before deadlines are clamped and re-filed. schedule() and
+// cancel() are O(1) and allocate nothing once the entry table has grown;
+// advance() moves an entry down a level at most three times before it
+// fires. Entries fire at most one tick late, never early. Handles carry a
+// generation, so cancelling one that already fired is harmless.
+//
+// Callbacks run from advance() may schedule and cancel freely.
+template <typename T>
+class TimerWheel
+{
+public:
+    typedef quint64 Handle;     // 0 is never a valid handle.
+
+    explicit TimerWheel(int tickMs = 4)
+        : m_tickMs(qMax(1, tickMs)),
+          m_currentTick(0),
+          m_count(0),
+          m_freeHead(-1),
+          m_firingHead(-1)
+    {
+        for (int &head : m_heads)
+            head = -1;
+        for (quint64 &mask : m_occupied)
+            mask = 0;
+    }
+
+    int size() const { return m_count; }
+    bool isEmpty() const { return m_count == 0; }
+
+    // Fires `value` once `dueMs` has passed on the clock given to advance().
+    Handle schedule(qint64 dueMs, T value)
+    {
+        int index = m_freeHead;
+        if (index >= 0) {
+            m_freeHead = m_entries[index].next;
+        } else {
+            index = m_entries.size();
+            m_entries.append(Entry());
+        }
+        Entry &entry = m_entries[index];
+        entry.dueTick = qMax(m_currentTick + 1, (dueMs + m_tickMs - 1) / m_tickMs);
+        entry.value = std::move(value);
+        entry.live = true;
+        ++m_count;
+        file(index);
+        return (quint64(entry.generation) << 32) | quint32(index + 1);
+    }
+
+    bool cancel(Handle handle)
+    {
+        const int index = int(quint32(handle)) - 1;
+        if (index < 0 || index >= m_entries.size())
+            return false;
+        Entry &entry = m_entries[index];
+        if (!entry.live || entry.generation != quint32(handle >> 32))
+            return false;
+        unlink(index);
+        release(index);
+        return true;
+    }
+
+    // Fires everything due by `nowMs`, oldest tick first, and returns how
+    // many entries fired. Idle ticks are skipped, so the cost follows the
+    // number of entries and cascades, not the time elapsed.
+    template <typename Fn>
+    int advance(qint64 nowMs, Fn &&expired)
+    {
+        const qint64 nowTick = nowMs / m_tickMs;
+        int fired = 0;
+        while (m_count > 0) {
+            const qint64 tick = nextTick();
+            if (tick > nowTick)
+                break;
+            m_currentTick = tick;
+            // Crossing a boundary brings the next coarser slot down a level.
+            for (int level = 1; level < Levels; ++level) {
+                const qint64 shifted = m_currentTick >> (SlotBits * (level - 1));
+                if (shifted & SlotMask)
+                    break;
+                cascade(level, int((m_currentTick >> (SlotBits * level)) & SlotMask));
+            }
+            const int slot = int(m_currentTick & SlotMask);
+            if (!(m_occupied[0] & (Q_UINT64_C(1) << slot)))
+                continue;
+            // Detach the slot first, so callbacks may cancel what is left.
+            m_firingHead = m_heads[slot];
+            m_heads[slot] = -1;
+            m_occupied[0] &= ~(Q_UINT64_C(1) << slot);
+            for (int index = m_firingHead; index >= 0; index = m_entries[index].next)
+                m_entries[index].slot = FiringSlot;
+            for (int index = m_firingHead; index >= 0; index = m_firingHead) {
+                m_firingHead = m_entries[index].next;
+                if (m_firingHead >= 0)
+                    m_entries[m_firingHead].prev = -1;
+                if (m_entries[index].dueTick > m_currentTick) {
+                    file(index);  // Clamped beyond the top level; still early.
+                    continue;
+                }
+                T value = std::move(m_entries[index].value);
+                release(index);
+                ++fired;
+                expired(value);
+            }
+        }
+        m_currentTick = qMax(m_currentTick, qMin(nowTick, nextTick() - 1));
+        return fired;
+    }
+
+    // Catches the wheel up with the clock without firing anything, so new
+    // entries are filed relative to now. Stops short of anything due.
+    void sync(qint64 nowMs)
+    {
+        m_currentTick = qMax(m_currentTick, qMin(nowMs / m_tickMs, nextTick() - 1));
+    }
+
+    // When advance() next has work to do: the earliest occupied tick of the
+    // finest level, or the earliest cascade of an occupied coarser slot.
+    // -1 when empty.
+    qint64 nextDueMs() const
+    {
+        return m_count ? nextTick() * m_tickMs : -1;
+    }
+
+private:
+    static const int SlotBits = 6;
+    static const int Slots = 1 << SlotBits;
+    static const qint64 SlotMask = Slots - 1;
+    static const int Levels = 4;
+    static const int FiringSlot = -2;
+
+    struct Entry {
+        qint64 dueTick = 0;
+        T value = T();
+        int prev = -1;
+        int next = -1;          // Also links the free list.
+        int slot = -1;          // Index into m_heads, or FiringSlot.
+        quint32 generation = 0;
+        bool live = false;
+    };
+
+    // First tick past the current one at which a slot of `level` is
+    // processed: fired at level 0, cascaded above. Slots are visited in
+    // order, so the first occupied one after the current is the answer.
+    qint64 nextTickAt(int level) const
+    {
+        const int shift = SlotBits * level;
+        const qint64 position = m_currentTick >> shift;
+        const int start = int((position + 1) & SlotMask);
+        const quint64 rotated = (m_occupied[level] >> start)
+                | (start ? m_occupied[level] << (Slots - start) : 0);
+        return (position + 1 + qCountTrailingZeroBits(rotated)) << shift;
+    }
+
+    qint64 nextTick() const
+    {
+        qint64 tick = std::numeric_limits<qint64>::max();
+        for (int level = 0; level < Levels; ++level) {
+            if (m_occupied[level])
+                tick = qMin(tick, nextTickAt(level));
+        }
+        return tick;
+    }
+
+    void file(int index)
+    {
+        Entry &entry = m_entries[index];
+        const qint64 maxDelta = (qint64(1) << (SlotBits * Levels)) - 1;
+        const qint64 tick = qMin(entry.dueTick, m_currentTick + maxDelta);
+        const qint64 delta = tick - m_currentTick;
+        int level = 0;
+        while (level < Levels - 1 && delta >= (qint64(1) << (SlotBits * (level + 1))))
+            ++level;
+        const int slotInLevel = int((tick >> (SlotBits * level)) & SlotMask);
+        const int slot = level * Slots + slotInLevel;
+        entry.slot = slot;
+        entry.prev = -1;
+        entry.next = m_heads[slot];
+        if (entry.next >= 0)
+            m_entries[entry.next].prev = index;
+        m_heads[slot] = index;
+        m_occupied[level] |= Q_UINT64_C(1) << slotInLevel;
+    }
+
+    void unlink(int index)
+    {
+        Entry &entry = m_entries[index];
+        int &head = entry.slot == FiringSlot ? m_firingHead : m_heads[entry.slot];
+        if (entry.prev >= 0)
+            m_entries[entry.prev].next = entry.next;
+        else
+            head = entry.next;
+        if (entry.next >= 0)
+            m_entries[entry.next].prev = entry.prev;
+        if (entry.slot != FiringSlot && m_heads[entry.slot] < 0)
+            m_occupied[entry.slot / Slots] &= ~(Q_UINT64_C(1) << (entry.slot % Slots));
+    }
+
+    void release(int index)
+    {
+        Entry &entry = m_entries[index];
+        entry.value = T();
+        entry.live = false;
+        ++entry.generation;
+        entry.next = m_freeHead;
+        m_freeHead = index;
+        --m_count;
+    }
+
+    void cascade(int level, int slotInLevel)
+    {
+        const int slot = level * Slots + slotInLevel;
+        int index = m_heads[slot];
+        m_heads[slot] = -1;
+        m_occupied[level] &= ~(Q_UINT64_C(1) << slotInLevel);
+        while (index >= 0) {
+            const int next = m_entries[index].next;
+            file(index);
+            index = next;
+        }
+    }
+
+    int m_tickMs;
+    qint64 m_currentTick;           // Every tick up to this one has been processed.
+    int m_count;
+    QVector<Entry> m_entries;       // Indexed by handle; grows, never shrinks.
+    int m_freeHead;
+    int m_firingHead;               // Slot being fired by advance().
+    int m_heads[Slots * Levels];
+    quint64 m_occupied[Levels];     // Non-empty slots, one bit each.
+};
+
+#endif // TIMERWHEEL_H
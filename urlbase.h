@@ -21,6 +21,7 @@
 #define DISCOVERY "/rest/system/discovery"
 #define REQUESTCONNECTION "/rest/config/devices"
 #define SYNCTHINGLOG "/rest/system/log"
+#define EVENTS "/rest/events"
 
 
 #endif // URLBASE_H
@@ -0,0 +1,98 @@
+#include "xxhash64.h"
+#include <QtEndian>
+#include <cstring>
+
+namespace {
+
+const quint64 Prime1 = Q_UINT64_C(0x9E3779B185EBCA87);
+const quint64 Prime2 = Q_UINT64_C(0xC2B2AE3D27D4EB4F);
+const quint64 Prime3 = Q_UINT64_C(0x165667B19E3779F9);
+const quint64 Prime4 = Q_UINT64_C(0x85EBCA77C2B2AE63);
+const quint64 Prime5 = Q_UINT64_C(0x27D4EB2F165667C5);
+
+inline quint64 rotl(quint64 value, int bits)
+{
+    return (value << bits) | (value >> (64 - bits));
+}
+
+// Unaligned little-endian loads; memcpy compiles down to a single move.
+inline quint64 read64(const char *p)
+{
+    quint64 value;
+    std::memcpy(&value, p, sizeof(value));
+    return qFromLittleEndian(value);
+}
+
+inline quint32 read32(const char *p)
+{
+    quint32 value;
+    std::memcpy(&value, p, sizeof(value));
+    return qFromLittleEndian(value);
+}
+
+inline quint64 round(quint64 acc, quint64 input)
+{
+    acc += input * Prime2;
+    return rotl(acc, 31) * Prime1;
+}
+
+inline quint64 mergeRound(quint64 acc, quint64 value)
+{
+    acc ^= round(0, value);
+    return acc * Prime1 + Prime4;
+}
+
+} // namespace
+
+quint64 xxHash64(const char *data, qint64 size, quint64 seed)
+{
+    const char *p = data;
+    const char *end = data + size;
+    quint64 hash;
+
+    if (size >= 32) {
+        // Four independent lanes keep the multipliers busy.
+        quint64 v1 = seed + Prime1 + Prime2;
+        quint64 v2 = seed + Prime2;
+        quint64 v3 = seed;
+        quint64 v4 = seed - Prime1;
+        const char *limit = end - 32;
+        do {
+            v1 = round(v1, read64(p));
+            v2 = round(v2, read64(p + 8));
+            v3 = round(v3, read64(p + 16));
+            v4 = round(v4, read64(p + 24));
+            p += 32;
+        } while (p <= limit);
+        hash = rotl(v1, 1) + rotl(v2, 7) + rotl(v3, 12) + rotl(v4, 18);
+        hash = mergeRound(hash, v1);
+        hash = mergeRound(hash, v2);
+        hash = mergeRound(hash, v3);
+        hash = mergeRound(hash, v4);
+    } else {
+        hash = seed + Prime5;
+    }
+    hash += quint64(size);
+
+    for (; p + 8 <= end; p += 8) {
+        hash ^= round(0, read64(p));
+        hash = rotl(hash, 27) * Prime1 + Prime4;
+    }
+    if (p + 4 <= end) {
+        hash ^= quint64(read32(p)) * Prime1;
+        hash = rotl(hash, 23) * Prime2 + Prime3;
+        p += 4;
+    }
+    for (; p < end; ++p) {
+        hash ^= quint64(quint8(*p)) * Prime5;
+        hash = rotl(hash, 11) * Prime1;
+    }
+
+    // Avalanche.
+    hash ^= hash >> 33;
+    hash *= Prime2;
+    hash ^= hash >> 29;
+    hash *= Prime3;
+    hash ^= hash >> 32;
+    return hash;
+}
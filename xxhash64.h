@@ -0,0 +1,17 @@
+#ifndef XXHASH64_H
+#define XXHASH64_H
+
+#include <QtGlobal>
+#include <QByteArray>
+
+// XXH64 from Yann Collet's xxHash: a fast non-cryptographic 64-bit hash,
+// bit-for-bit compatible with the reference implementation. Good for
+// telling bodies apart, useless against anyone forging collisions.
+quint64 xxHash64(const char *data, qint64 size, quint64 seed = 0);
+
+inline quint64 xxHash64(const QByteArray &data, quint64 seed = 0)
+{
+    return xxHash64(data.constData(), data.size(), seed);
+}
+
+#endif // XXHASH64_H